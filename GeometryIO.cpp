@@ -1,5 +1,12 @@
 #include "GeometryIO.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
 #include "fpzip/fpzip.h"
 
 
@@ -15,11 +22,29 @@
 #ifdef USE_LZMA2
 #include "lzma/Lzma2Enc.h"
 #include "lzma/Lzma2Dec.h"
+#include "lzma/Lzma2DecMt.h"
 #else
 #include "lzma/LzmaEnc.h"
 #include "lzma/LzmaDec.h"
 #endif
 
+#include "lzma/CpuArch.h"
+
+#ifdef MY_CPU_AMD64
+#include <immintrin.h>
+
+#define USE_SSE2
+#define USE_AVX2
+#define USE_BMI2
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define TARGET_BMI2 __attribute__((target("bmi2")))
+#else
+#define TARGET_AVX2
+#define TARGET_BMI2
+#endif
+#endif
+
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -30,7 +55,6 @@
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 
-extern fpzipError fpzip_errno;
 extern const char* const fpzip_errstr[];
 
 
@@ -41,6 +65,8 @@ namespace __hidden_GeometryIOProcessor
 {
 	static const char ERRPrefixFPZIP[] = "fpzip: ";
 	static const char ERRPrefixLZMA[] = "lzma: ";
+	static const char ERRPrefixLZ[] = "lz: ";
+	static const char ERRPrefixGeometry[] = "geometry: ";
 
 
 	void* CurGeometryIOProcessorAlloc(CustomIO* _this, unsigned long long size)
@@ -53,388 +79,2157 @@ namespace __hidden_GeometryIOProcessor
 	}
 
 	
-	thread_local CustomIO* FPZIPGeometryIOProcessor = nullptr;
-	void* FPZIPGeometryIOProcessorAlloc(unsigned long long size)
+	struct FPZctxForGeometry : public FPZctx
+	{
+		CustomIO* _this;
+	};
+	static void* FPZIPAlloc(FPZctx* raw, size_t size)
 	{
-		return CurGeometryIOProcessorAlloc(FPZIPGeometryIOProcessor, size);
+		return CurGeometryIOProcessorAlloc(static_cast<FPZctxForGeometry*>(raw)->_this, size);
 	}
-	void FPZIPGeometryIOProcessorFree(void* p)
+	static void FPZIPFree(FPZctx* raw, void* address)
 	{
-		return CurGeometryIOProcessorFree(FPZIPGeometryIOProcessor, p);
+		return CurGeometryIOProcessorFree(static_cast<FPZctxForGeometry*>(raw)->_this, address);
 	}
-	
 
-	struct ISzAllocForGeometry : public ISzAlloc
-	{
-		CustomIO* _this;
-	};
-	static void* LZMAAlloc(ISzAllocPtr raw, size_t size)
+	// vertices per fpzip chunk, 0 when SrcCount coordinates are coded as one stream
+	static unsigned long VertexChunkPoints(const GeometryWriter::EncodeOptions& Options, unsigned long SrcCount)
 	{
-		return CurGeometryIOProcessorAlloc(static_cast<const ISzAllocForGeometry*>(raw)->_this, size);
+		const unsigned long ChunkPoints = (Options.VertexChunkSize > 0u) ? Options.VertexChunkSize : (1u << 18u);
+		if (((SrcCount % 3u) != 0u) || ((SrcCount / 3u) <= ChunkPoints))
+		{
+			return 0u;
+		}
+		return ChunkPoints;
 	}
-	static void LZMAFree(ISzAllocPtr raw, void* address)
+
+#ifdef USE_AVX2
+	static bool HasAVX2()
 	{
-		return CurGeometryIOProcessorFree(static_cast<const ISzAllocForGeometry*>(raw)->_this, address);
+		static const bool bSupported = (CPU_IsSupported_AVX2() != 0);
+		return bSupported;
 	}
+#endif
 
 
-#ifdef USE_LZMA2
-	static SRes LZMA2Encode(Byte* dest, SizeT* destLen, Byte* prop, const Byte* src, SizeT srcLen, const CLzma2EncProps* props, ICompressProgress* progress, ISzAllocPtr alloc, ISzAllocPtr allocBig)
+	// one point in the same order as ComputeMinMax, so world space vertices match the header bounds. a null Transform only converts
+	template<typename U>
+	static void TransformPoint(const VertexTransform* Transform, double X, double Y, double Z, U* Dest)
 	{
-		CLzma2EncHandle p = Lzma2Enc_Create(alloc, allocBig);
-		if (!p)
+		if (Transform)
 		{
-			return SZ_ERROR_MEM;
+			X *= Transform->Scale[0];
+			Y *= Transform->Scale[1];
+			Z *= Transform->Scale[2];
 		}
 
-		SRes res = SZ_OK;
-		do
+		if (Transform && Transform->bRotate)
 		{
-			res = Lzma2Enc_SetProps(p, props);
-			if (res != SZ_OK)
-			{
-				break;
-			}
+			const double* Rotation = Transform->Rotation;
 
-			(*prop) = Lzma2Enc_WriteProperties(p);
-			
-			Lzma2Enc_SetDataSize(p, srcLen);
-			
-			res = Lzma2Enc_Encode2(p, nullptr, dest, destLen, nullptr, src, srcLen, progress);
-			if (res != SZ_OK)
-			{
-				break;
-			}
-		}
-		while (false);
+			double TTX = 2. * (Rotation[1] * Z - Rotation[2] * Y);
+			double TTY = 2. * (Rotation[2] * X - Rotation[0] * Z);
+			double TTZ = 2. * (Rotation[0] * Y - Rotation[1] * X);
 
-		Lzma2Enc_Destroy(p);
-		return res;
-	}
-	static SRes LZMA2Decode(Byte* dest, SizeT* destLen, const Byte* src, SizeT* srcLen, Byte prop, ELzmaFinishMode finishMode, ELzmaStatus* status, ISzAllocPtr alloc)
-	{
-		CLzma2Dec p;
-		Lzma2Dec_Construct(&p);
+			const double TT2X = 2. * (Rotation[1] * TTZ - Rotation[2] * TTY);
+			const double TT2Y = 2. * (Rotation[2] * TTX - Rotation[0] * TTZ);
+			const double TT2Z = 2. * (Rotation[0] * TTY - Rotation[1] * TTX);
 
-		SizeT outSize = *destLen;
-		SizeT inSize = *srcLen;
+			TTX *= Rotation[3];
+			TTY *= Rotation[3];
+			TTZ *= Rotation[3];
 
-		*destLen = 0u;
-		*srcLen = 0u;
+			X += TTX + TT2X;
+			Y += TTY + TT2Y;
+			Z += TTZ + TT2Z;
 
-		*status = LZMA_STATUS_NOT_SPECIFIED;
-		
-		SRes res = Lzma2Dec_AllocateProbs(&p, prop, alloc);
-		if (res != SZ_OK)
-		{
-			return res;
+			X += Transform->Translation[0];
+			Y += Transform->Translation[1];
+			Z += Transform->Translation[2];
 		}
-		
-		p.decoder.dic = dest;
-		p.decoder.dicBufSize = outSize;
-		Lzma2Dec_Init(&p);
-
-		*srcLen = inSize;
 
-		res = Lzma2Dec_DecodeToDic(&p, outSize, src, srcLen, finishMode, status);
-		*destLen = p.decoder.dicPos;
-		if (res == SZ_OK && *status == LZMA_STATUS_NEEDS_MORE_INPUT)
+		Dest[0] = static_cast<U>(X);
+		Dest[1] = static_cast<U>(Y);
+		Dest[2] = static_cast<U>(Z);
+	}
+	// Count points from the planes X, Y and Z into Dest, interleaved
+	template<typename T, typename U>
+	static void TransformPlanarRun(const VertexTransform* Transform, const T* X, const T* Y, const T* Z, unsigned long long Count, U* Dest)
+	{
+		for (unsigned long long i = 0u; i < Count; ++i, Dest += 3u)
 		{
-			res = SZ_ERROR_INPUT_EOF;
+			TransformPoint(Transform, static_cast<double>(X[i]), static_cast<double>(Y[i]), static_cast<double>(Z[i]), Dest);
 		}
-		
-		Lzma2Dec_FreeProbs(&p, alloc);
-		
-		return res;
 	}
-#endif
-
-
-	static void FPZIPGetErrorMsg(fpzipError Err, TempBuffer<char>* Buffer)
+	// Count interleaved points from Src into Dest, which may be Src itself
+	template<typename T, typename U>
+	static void TransformInterleavedRun(const VertexTransform* Transform, const T* Src, U* Dest, unsigned long long Count)
 	{
-		const char* Msg = fpzip_errstr[Err];
-
-		const unsigned long long PrefixLen = strlen(ERRPrefixFPZIP);
-		const unsigned long long MsgLen = strlen(Msg);
-		const unsigned long long TotalLen = PrefixLen + MsgLen + 1;
-		Buffer->Resize(TotalLen);
-		Memcpy(Buffer->Get(), ERRPrefixFPZIP, PrefixLen);
-		Memcpy(Buffer->Get() + TotalLen, Msg, MsgLen);
-		*(Buffer->Get() + (TotalLen - 1)) = 0u;
+		for (const T* SrcEnd = Src + (Count * 3u); Src != SrcEnd; Src += 3u, Dest += 3u)
+		{
+			TransformPoint(Transform, static_cast<double>(Src[0]), static_cast<double>(Src[1]), static_cast<double>(Src[2]), Dest);
+		}
 	}
-	
-	static void LZMAGetErrorMsg(SRes Err, TempBuffer<char>* Buffer)
+
+#ifdef USE_SSE2
+	// Consts holds Scale, Rotation and Translation broadcast, 10 in all
+	static void TransformSSE2(const __m128d* Consts, bool bRotate, __m128d* X, __m128d* Y, __m128d* Z)
 	{
-		const char* Msg;
-		switch(Err)
-		{
-		case SZ_ERROR_DATA:
-			Msg = MAKE_TEXT(SZ_ERROR_DATA);
-			break;
-		case SZ_ERROR_MEM:
-			Msg = MAKE_TEXT(SZ_ERROR_MEM);
-			break;
-		case SZ_ERROR_CRC:
-			Msg = MAKE_TEXT(SZ_ERROR_CRC);
-			break;
-		case SZ_ERROR_UNSUPPORTED:
-			Msg = MAKE_TEXT(SZ_ERROR_UNSUPPORTED);
-			break;
-		case SZ_ERROR_PARAM:
-			Msg = MAKE_TEXT(SZ_ERROR_PARAM);
-			break;
-		case SZ_ERROR_INPUT_EOF:
-			Msg = MAKE_TEXT(SZ_ERROR_INPUT_EOF);
-			break;
-		case SZ_ERROR_OUTPUT_EOF:
-			Msg = MAKE_TEXT(SZ_ERROR_OUTPUT_EOF);
-			break;
-		case SZ_ERROR_READ:
-			Msg = MAKE_TEXT(SZ_ERROR_READ);
-			break;
-		case SZ_ERROR_WRITE:
-			Msg = MAKE_TEXT(SZ_ERROR_WRITE);
-			break;
-		case SZ_ERROR_PROGRESS:
-			Msg = MAKE_TEXT(SZ_ERROR_PROGRESS);
-			break;
-		case SZ_ERROR_FAIL:
-			Msg = MAKE_TEXT(SZ_ERROR_FAIL);
-			break;
-		case SZ_ERROR_THREAD:
-			Msg = MAKE_TEXT(SZ_ERROR_THREAD);
-			break;
+		(*X) = _mm_mul_pd(*X, Consts[0]);
+		(*Y) = _mm_mul_pd(*Y, Consts[1]);
+		(*Z) = _mm_mul_pd(*Z, Consts[2]);
 
-		case SZ_ERROR_ARCHIVE:
-			Msg = MAKE_TEXT(SZ_ERROR_ARCHIVE);
-			break;
-		case SZ_ERROR_NO_ARCHIVE:
-			Msg = MAKE_TEXT(SZ_ERROR_NO_ARCHIVE);
-			break;
+		if (bRotate)
+		{
+			const __m128d Two = _mm_set1_pd(2.);
+			const __m128d R0 = Consts[3], R1 = Consts[4], R2 = Consts[5], R3 = Consts[6];
 
-		default:
-			Msg = "";
-			break;
-		}
+			__m128d TTX = _mm_mul_pd(Two, _mm_sub_pd(_mm_mul_pd(R1, *Z), _mm_mul_pd(R2, *Y)));
+			__m128d TTY = _mm_mul_pd(Two, _mm_sub_pd(_mm_mul_pd(R2, *X), _mm_mul_pd(R0, *Z)));
+			__m128d TTZ = _mm_mul_pd(Two, _mm_sub_pd(_mm_mul_pd(R0, *Y), _mm_mul_pd(R1, *X)));
 
-		const unsigned long long PrefixLen = strlen(ERRPrefixLZMA);
-		const unsigned long long MsgLen = strlen(Msg);
-		const unsigned long long TotalLen = PrefixLen + MsgLen + 1;
-		Buffer->Resize(TotalLen);
-		Memcpy(Buffer->Get(), ERRPrefixLZMA, PrefixLen);
-		Memcpy(Buffer->Get() + TotalLen, Msg, MsgLen);
-		*(Buffer->Get() + (TotalLen - 1)) = 0u;
-	}
+			const __m128d TT2X = _mm_mul_pd(Two, _mm_sub_pd(_mm_mul_pd(R1, TTZ), _mm_mul_pd(R2, TTY)));
+			const __m128d TT2Y = _mm_mul_pd(Two, _mm_sub_pd(_mm_mul_pd(R2, TTX), _mm_mul_pd(R0, TTZ)));
+			const __m128d TT2Z = _mm_mul_pd(Two, _mm_sub_pd(_mm_mul_pd(R0, TTY), _mm_mul_pd(R1, TTX)));
 
+			TTX = _mm_mul_pd(TTX, R3);
+			TTY = _mm_mul_pd(TTY, R3);
+			TTZ = _mm_mul_pd(TTZ, R3);
 
-	static double Abs64(double V)
-	{
-		unsigned long long* CurBitsPtr = reinterpret_cast<unsigned long long*>(&V);
-		unsigned long long CurBits = *CurBitsPtr;
-		CurBits <<= 1u;
-		CurBits >>= 1u;
-		(*CurBitsPtr) = CurBits;
-		return V;
+			(*X) = _mm_add_pd(_mm_add_pd(*X, _mm_add_pd(TTX, TT2X)), Consts[7]);
+			(*Y) = _mm_add_pd(_mm_add_pd(*Y, _mm_add_pd(TTY, TT2Y)), Consts[8]);
+			(*Z) = _mm_add_pd(_mm_add_pd(*Z, _mm_add_pd(TTZ, TT2Z)), Consts[9]);
+		}
 	}
-	static float Abs32(float V)
+	static void BroadcastSSE2(const VertexTransform* Transform, __m128d* Consts)
 	{
-		unsigned long* CurBitsPtr = reinterpret_cast<unsigned long*>(&V);
-		unsigned long CurBits = *CurBitsPtr;
-		CurBits <<= 1u;
-		CurBits >>= 1u;
-		(*CurBitsPtr) = CurBits;
-		return V;
+		for (unsigned long k = 0u; k < 3u; ++k)
+		{
+			Consts[k] = _mm_set1_pd(Transform->Scale[k]);
+			Consts[7u + k] = _mm_set1_pd(Transform->Translation[k]);
+		}
+		for (unsigned long k = 0u; k < 4u; ++k)
+		{
+			Consts[3u + k] = _mm_set1_pd(Transform->Rotation[k]);
+		}
 	}
-	
-	
-	static double Rsqrt64_base(double V)
+	static __m128d LoadPairSSE2(const double* Src)
 	{
-		double X2 = V * 0.5;
-		double Y = V;
-		unsigned long long I = *reinterpret_cast<unsigned long long*>(&Y);
-		I = 0x5fe6eb50c7b537a9 - (I >> 1);
-		Y = *reinterpret_cast<double*>(&I);
-		Y = Y * (1.5 - (X2 * Y * Y));
-		return Y;
+		return _mm_loadu_pd(Src);
 	}
-	static float Rsqrt32_base(float V)
+	static __m128d LoadPairSSE2(const float* Src)
 	{
-		float X2 = V * 0.5f;
-		float Y = V;
-		unsigned long I = *reinterpret_cast<unsigned long*>(&Y);
-		I = 0x5F3759DF - (I >> 1);
-		Y = *reinterpret_cast<float*>(&I);
-		Y = Y * (1.5f - (X2 * Y * Y));
-		return Y;
+		return _mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(Src))));
 	}
-	
-	static double Rsqrt64(double V)
+	static void StorePairSSE2(double* Dest, __m128d V)
 	{
-		double X2 = V * 0.5;
-		double Y = Rsqrt64_base(V);
-
-		// more newton iteration for accuracy
-		Y = Y * (1.5 - (X2 * Y * Y));
-		Y = Y * (1.5 - (X2 * Y * Y));
-
-		return Y;
+		_mm_storeu_pd(Dest, V);
 	}
-	static float Rsqrt32(float V)
+	static void StorePairSSE2(float* Dest, __m128d V)
 	{
-		float X2 = V * 0.5f;
-		float Y = Rsqrt32_base(V);
-
-		// more newton iteration for accuracy
-		Y = Y * (1.5f - (X2 * Y * Y));
-		Y = Y * (1.5f - (X2 * Y * Y));
-
-		return Y;
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(Dest), _mm_castps_si128(_mm_cvtpd_ps(V)));
 	}
-	
-	static double Sqrt64(double V)
+	// [x0 y0] [z0 x1] [y1 z1] to and from [x0 x1] [y0 y1] [z0 z1]
+	template<typename T>
+	static void LoadInterleavedSSE2(const T* Src, __m128d* X, __m128d* Y, __m128d* Z)
 	{
-		double Y = 1. / Rsqrt64(V);
+		const __m128d A = LoadPairSSE2(Src);
+		const __m128d B = LoadPairSSE2(Src + 2u);
+		const __m128d C = LoadPairSSE2(Src + 4u);
 
-		return Y;
+		(*X) = _mm_shuffle_pd(A, B, 0x2);
+		(*Y) = _mm_shuffle_pd(A, C, 0x1);
+		(*Z) = _mm_shuffle_pd(B, C, 0x2);
 	}
-	static float Sqrt32(float V)
+	template<typename U>
+	static void StoreInterleavedSSE2(U* Dest, __m128d X, __m128d Y, __m128d Z)
 	{
-		float Y = 1.f / Rsqrt32(V);
-
-		return Y;
+		StorePairSSE2(Dest, _mm_unpacklo_pd(X, Y));
+		StorePairSSE2(Dest + 2u, _mm_shuffle_pd(Z, X, 0x2));
+		StorePairSSE2(Dest + 4u, _mm_unpackhi_pd(Y, Z));
 	}
-};
-
-
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+	template<typename T, typename U>
+	static void TransformPlanarSSE2(const VertexTransform* Transform, const T* X, const T* Y, const T* Z, unsigned long long Count, U* Dest)
+	{
+		__m128d Consts[10];
+		if (Transform)
+		{
+			BroadcastSSE2(Transform, Consts);
+		}
 
-bool __common_memset(void* Dest, int V, size_t Len)
-{
-	return __hidden_GeometryIOProcessor::Memset(reinterpret_cast<unsigned char*>(Dest), static_cast<unsigned char>(V), Len);
-}
-bool __common_memmove(void* Dest, const void* Src, size_t Len)
-{
-	return __hidden_GeometryIOProcessor::Memmove(Dest, Src, Len);
-}
-bool __common_memcpy(void* _restrict Dest, const void* _restrict Src, size_t Len)
-{
-	return __hidden_GeometryIOProcessor::Memcpy(Dest, Src, Len);
-}
+		unsigned long long i = 0u;
+		for (const unsigned long long e = Count & ~1ull; i != e; i += 2u, Dest += 6u)
+		{
+			__m128d VX = LoadPairSSE2(X + i);
+			__m128d VY = LoadPairSSE2(Y + i);
+			__m128d VZ = LoadPairSSE2(Z + i);
 
+			if (Transform)
+			{
+				TransformSSE2(Consts, Transform->bRotate, &VX, &VY, &VZ);
+			}
+			StoreInterleavedSSE2(Dest, VX, VY, VZ);
+		}
+		TransformPlanarRun(Transform, X + i, Y + i, Z + i, Count - i, Dest);
+	}
+	template<typename T, typename U>
+	static void TransformInterleavedSSE2(const VertexTransform* Transform, const T* Src, U* Dest, unsigned long long Count)
+	{
+		__m128d Consts[10];
+		if (Transform)
+		{
+			BroadcastSSE2(Transform, Consts);
+		}
 
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+		const T* SrcEnd = Src + ((Count & ~1ull) * 3u);
+		for (; Src != SrcEnd; Src += 6u, Dest += 6u)
+		{
+			__m128d X, Y, Z;
+			LoadInterleavedSSE2(Src, &X, &Y, &Z);
 
+			if (Transform)
+			{
+				TransformSSE2(Consts, Transform->bRotate, &X, &Y, &Z);
+			}
+			StoreInterleavedSSE2(Dest, X, Y, Z);
+		}
+		TransformInterleavedRun(Transform, Src, Dest, Count & 1u);
+	}
+#endif
 
-void* __fpzip_alloc(size_t size)
-{
-	return __hidden_GeometryIOProcessor::FPZIPGeometryIOProcessorAlloc(size);
-}
-void __fpzip_free(void* p)
-{
-	return __hidden_GeometryIOProcessor::FPZIPGeometryIOProcessorFree(p);
-}
+#ifdef USE_AVX2
+	TARGET_AVX2 static void TransformAVX2(const __m256d* Consts, bool bRotate, __m256d* X, __m256d* Y, __m256d* Z)
+	{
+		(*X) = _mm256_mul_pd(*X, Consts[0]);
+		(*Y) = _mm256_mul_pd(*Y, Consts[1]);
+		(*Z) = _mm256_mul_pd(*Z, Consts[2]);
 
+		if (bRotate)
+		{
+			const __m256d Two = _mm256_set1_pd(2.);
+			const __m256d R0 = Consts[3], R1 = Consts[4], R2 = Consts[5], R3 = Consts[6];
 
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+			__m256d TTX = _mm256_mul_pd(Two, _mm256_sub_pd(_mm256_mul_pd(R1, *Z), _mm256_mul_pd(R2, *Y)));
+			__m256d TTY = _mm256_mul_pd(Two, _mm256_sub_pd(_mm256_mul_pd(R2, *X), _mm256_mul_pd(R0, *Z)));
+			__m256d TTZ = _mm256_mul_pd(Two, _mm256_sub_pd(_mm256_mul_pd(R0, *Y), _mm256_mul_pd(R1, *X)));
 
+			const __m256d TT2X = _mm256_mul_pd(Two, _mm256_sub_pd(_mm256_mul_pd(R1, TTZ), _mm256_mul_pd(R2, TTY)));
+			const __m256d TT2Y = _mm256_mul_pd(Two, _mm256_sub_pd(_mm256_mul_pd(R2, TTX), _mm256_mul_pd(R0, TTZ)));
+			const __m256d TT2Z = _mm256_mul_pd(Two, _mm256_sub_pd(_mm256_mul_pd(R0, TTY), _mm256_mul_pd(R1, TTX)));
 
-bool GeometryWriter::Encode(
-	const double* Scale,
-	const double* Rotation,
-	const double* Position,
-	unsigned long VertCount,
-	unsigned long IndCount,
-	const double* Verts,
-	const unsigned long* Inds,
-	unsigned long long* EncodedSize,
-	unsigned char** EncodedData,
+			TTX = _mm256_mul_pd(TTX, R3);
+			TTY = _mm256_mul_pd(TTY, R3);
+			TTZ = _mm256_mul_pd(TTZ, R3);
 
-	unsigned long OptionalEncodeOffset,
-	bool OptionalUseFloat32Vertex
-	)
-{
+			(*X) = _mm256_add_pd(_mm256_add_pd(*X, _mm256_add_pd(TTX, TT2X)), Consts[7]);
+			(*Y) = _mm256_add_pd(_mm256_add_pd(*Y, _mm256_add_pd(TTY, TT2Y)), Consts[8]);
+			(*Z) = _mm256_add_pd(_mm256_add_pd(*Z, _mm256_add_pd(TTZ, TT2Z)), Consts[9]);
+		}
+	}
+	TARGET_AVX2 static void BroadcastAVX2(const VertexTransform* Transform, __m256d* Consts)
 	{
-		const SizeT VertLen = (VertCount << 3u);
-		const SizeT IndLen = (IndCount << 2u);
-		
-		SizeT InitLen = ((3u + 4u + 3u) << 3u);
-		InitLen += 4u + 4u + 8u + 8u;
-		InitLen += VertLen;
-		InitLen += IndLen;
-		
-		TempSrcForEncoding.Resize(InitLen);
-		unsigned char* Ptr = TempSrcForEncoding.Get();
+		for (unsigned long k = 0u; k < 3u; ++k)
+		{
+			Consts[k] = _mm256_set1_pd(Transform->Scale[k]);
+			Consts[7u + k] = _mm256_set1_pd(Transform->Translation[k]);
+		}
+		for (unsigned long k = 0u; k < 4u; ++k)
+		{
+			Consts[3u + k] = _mm256_set1_pd(Transform->Rotation[k]);
+		}
+	}
+	TARGET_AVX2 static __m256d LoadQuadAVX2(const double* Src)
+	{
+		return _mm256_loadu_pd(Src);
+	}
+	TARGET_AVX2 static __m256d LoadQuadAVX2(const float* Src)
+	{
+		return _mm256_cvtps_pd(_mm_loadu_ps(Src));
+	}
+	TARGET_AVX2 static void StoreQuadAVX2(double* Dest, __m256d V)
+	{
+		_mm256_storeu_pd(Dest, V);
+	}
+	TARGET_AVX2 static void StoreQuadAVX2(float* Dest, __m256d V)
+	{
+		_mm_storeu_ps(Dest, _mm256_cvtpd_ps(V));
+	}
+	// [x0 y0 z0 x1] [y1 z1 x2 y2] [z2 x3 y3 z3] to and from [x0 x1 x2 x3] [y0 y1 y2 y3] [z0 z1 z2 z3], through [x0 y0 x2 y2] [z0 x1 z2 x3] [y1 z1 y3 z3]
+	template<typename T>
+	TARGET_AVX2 static void LoadInterleavedAVX2(const T* Src, __m256d* X, __m256d* Y, __m256d* Z)
+	{
+		const __m256d A = LoadQuadAVX2(Src);
+		const __m256d B = LoadQuadAVX2(Src + 4u);
+		const __m256d C = LoadQuadAVX2(Src + 8u);
 
-		__hidden_GeometryIOProcessor::MemcpyAndMove(Ptr, Scale, 3u << 3u);
-		__hidden_GeometryIOProcessor::MemcpyAndMove(Ptr, Rotation, 4u << 3u);
-		__hidden_GeometryIOProcessor::MemcpyAndMove(Ptr, Position, 3u << 3u);
-		
-		__hidden_GeometryIOProcessor::MemcpyAndMove(Ptr, &VertCount, 4u);
-		__hidden_GeometryIOProcessor::MemcpyAndMove(Ptr, &IndCount, 4u);
-		
-		__hidden_GeometryIOProcessor::MemsetAndMove(Ptr, static_cast<unsigned char>(0), 8u);
-		__hidden_GeometryIOProcessor::MemsetAndMove(Ptr, static_cast<unsigned char>(0), 8u);
+		const __m256d P = _mm256_blend_pd(A, B, 0xC);
+		const __m256d Q = _mm256_permute2f128_pd(A, C, 0x21);
+		const __m256d R = _mm256_permute2f128_pd(B, C, 0x30);
 
-		__hidden_GeometryIOProcessor::MemcpyAndMove(Ptr, Verts, VertLen);
-		__hidden_GeometryIOProcessor::Memcpy(Ptr, Inds, IndLen);
+		(*X) = _mm256_shuffle_pd(P, Q, 0xA);
+		(*Y) = _mm256_shuffle_pd(P, R, 0x5);
+		(*Z) = _mm256_shuffle_pd(Q, R, 0xA);
 	}
-	
-	if (!Pack(OptionalUseFloat32Vertex))
+	template<typename U>
+	TARGET_AVX2 static void StoreInterleavedAVX2(U* Dest, __m256d X, __m256d Y, __m256d Z)
 	{
-		return false;
+		const __m256d P = _mm256_shuffle_pd(X, Y, 0x0);
+		const __m256d Q = _mm256_shuffle_pd(Z, X, 0xA);
+		const __m256d R = _mm256_shuffle_pd(Y, Z, 0xF);
+
+		StoreQuadAVX2(Dest, _mm256_permute2f128_pd(P, Q, 0x20));
+		StoreQuadAVX2(Dest + 4u, _mm256_permute2f128_pd(R, P, 0x30));
+		StoreQuadAVX2(Dest + 8u, _mm256_permute2f128_pd(Q, R, 0x31));
 	}
 
+	template<typename T, typename U>
+	TARGET_AVX2 static void TransformPlanarAVX2(const VertexTransform* Transform, const T* X, const T* Y, const T* Z, unsigned long long Count, U* Dest)
 	{
-		__hidden_GeometryIOProcessor::ISzAllocForGeometry allocator;
+		__m256d Consts[10];
+		if (Transform)
 		{
-			allocator.Alloc = __hidden_GeometryIOProcessor::LZMAAlloc;
-			allocator.Free = __hidden_GeometryIOProcessor::LZMAFree;
-			allocator._this = this;
+			BroadcastAVX2(Transform, Consts);
+		}
+
+		unsigned long long i = 0u;
+		for (const unsigned long long e = Count & ~3ull; i != e; i += 4u, Dest += 12u)
+		{
+			__m256d VX = LoadQuadAVX2(X + i);
+			__m256d VY = LoadQuadAVX2(Y + i);
+			__m256d VZ = LoadQuadAVX2(Z + i);
+
+			if (Transform)
+			{
+				TransformAVX2(Consts, Transform->bRotate, &VX, &VY, &VZ);
+			}
+			StoreInterleavedAVX2(Dest, VX, VY, VZ);
+		}
+		TransformPlanarRun(Transform, X + i, Y + i, Z + i, Count - i, Dest);
+	}
+	template<typename T, typename U>
+	TARGET_AVX2 static void TransformInterleavedAVX2(const VertexTransform* Transform, const T* Src, U* Dest, unsigned long long Count)
+	{
+		__m256d Consts[10];
+		if (Transform)
+		{
+			BroadcastAVX2(Transform, Consts);
+		}
+
+		const T* SrcEnd = Src + ((Count & ~3ull) * 3u);
+		for (; Src != SrcEnd; Src += 12u, Dest += 12u)
+		{
+			__m256d X, Y, Z;
+			LoadInterleavedAVX2(Src, &X, &Y, &Z);
+
+			if (Transform)
+			{
+				TransformAVX2(Consts, Transform->bRotate, &X, &Y, &Z);
+			}
+			StoreInterleavedAVX2(Dest, X, Y, Z);
+		}
+		TransformInterleavedRun(Transform, Src, Dest, Count & 3u);
+	}
+#endif
+
+	// PointCount points from the three planes at Src into Dest, interleaved. a null Transform only converts
+	template<typename T, typename U>
+	static void TransformPlanar(const VertexTransform* Transform, const T* Src, unsigned long PointCount, U* Dest)
+	{
+		const T* X = Src;
+		const T* Y = X + PointCount;
+		const T* Z = Y + PointCount;
+
+#ifdef USE_AVX2
+		if (HasAVX2())
+		{
+			TransformPlanarAVX2(Transform, X, Y, Z, PointCount, Dest);
+			return;
+		}
+#endif
+#ifdef USE_SSE2
+		TransformPlanarSSE2(Transform, X, Y, Z, PointCount, Dest);
+#else
+		TransformPlanarRun(Transform, X, Y, Z, PointCount, Dest);
+#endif
+	}
+	// Count interleaved coordinates from Src into Dest, which may be Src itself when they share a type. a null Transform only converts,
+	// and coordinates past the last whole point are always only converted
+	template<typename T, typename U>
+	static void TransformInterleaved(const VertexTransform* Transform, const T* Src, U* Dest, unsigned long Count)
+	{
+		const unsigned long PointCount = Count / 3u;
+
+#ifdef USE_AVX2
+		if (HasAVX2())
+		{
+			TransformInterleavedAVX2(Transform, Src, Dest, PointCount);
+		}
+		else
+#endif
+		{
+#ifdef USE_SSE2
+			TransformInterleavedSSE2(Transform, Src, Dest, PointCount);
+#else
+			TransformInterleavedRun(Transform, Src, Dest, PointCount);
+#endif
+		}
+
+		for (unsigned long i = PointCount * 3u; i < Count; ++i)
+		{
+			Dest[i] = static_cast<U>(Src[i]);
+		}
+	}
+
+	// what the GetGeometry overloads without Scale decode into, as they return it applied
+	static GeometryReader::DecodeOptions::VertexSpaceType ScaledVertexSpace(GeometryReader::DecodeOptions::VertexSpaceType Space)
+	{
+		return (Space == GeometryReader::DecodeOptions::VERTEX_LOCAL) ? GeometryReader::DecodeOptions::VERTEX_SCALED : Space;
+	}
+
+	// codes Count coordinates as one fpzip stream, planar streams as three fields of Count / 3. Scratch holds Count doubles
+	static fpzipError FPZIPWriteChunk(CustomIO* IO, bool bFloatInRange, bool bPlanar, unsigned long Count, const double* Src, void* Scratch, void* Dest, unsigned long long DestCapacity, unsigned long long* DestCount)
+	{
+		FPZctxForGeometry context;
+		{
+			context.alloc = FPZIPAlloc;
+			context.dealloc = FPZIPFree;
+			context.error = fpzipSuccess;
+			context._this = IO;
+		}
+
+		const unsigned long PointCount = Count / 3u;
+
+		const void* Data = Scratch;
+		if (bFloatInRange)
+		{
+			// fpzip takes floats, so narrow into the scratch buffer first
+			float* Dest32 = reinterpret_cast<float*>(Scratch);
+			if (bPlanar)
+			{
+				for (unsigned long i = 0u; i < PointCount; ++i, Src += 3u)
+				{
+					Dest32[i] = static_cast<float>(Src[0]);
+					Dest32[PointCount + i] = static_cast<float>(Src[1]);
+					Dest32[(PointCount << 1u) + i] = static_cast<float>(Src[2]);
+				}
+			}
+			else
+			{
+				for (const double* SrcEnd = Src + Count; Src != SrcEnd; ++Src, ++Dest32)
+				{
+					*Dest32 = static_cast<float>(*Src);
+				}
+			}
+		}
+		else if (bPlanar)
+		{
+			double* Dest64 = reinterpret_cast<double*>(Scratch);
+			for (unsigned long i = 0u; i < PointCount; ++i, Src += 3u)
+			{
+				Dest64[i] = Src[0];
+				Dest64[PointCount + i] = Src[1];
+				Dest64[(PointCount << 1u) + i] = Src[2];
+			}
+		}
+		else
+		{
+			Data = Src;
+		}
+
+		FPZ* fpz = fpzip_write_to_buffer_ctx(&context, Dest, DestCapacity);
+		fpz->type = bFloatInRange ? FPZIP_TYPE_FLOAT : FPZIP_TYPE_DOUBLE;
+		fpz->nx = static_cast<decltype(fpz->nx)>(bPlanar ? PointCount : Count);
+		fpz->ny = 1;
+		fpz->nz = 1;
+		fpz->nf = bPlanar ? 3 : 1;
+
+		(*DestCount) = static_cast<unsigned long long>(fpzip_write(fpz, Data));
+
+		fpzip_write_close(fpz);
+
+		return context.error;
+	}
+	// decodes what FPZIPWriteChunk wrote into Count doubles or floats, passed through Transform unless it's null. Scratch holds Count doubles,
+	// and is only used by planar streams and by double streams read into floats
+	template<typename U>
+	static fpzipError FPZIPReadChunk(CustomIO* IO, bool bFloatInRange, bool bPlanar, unsigned long Count, const void* Src, void* Scratch, const VertexTransform* Transform, U* Dest)
+	{
+		FPZctxForGeometry context;
+		{
+			context.alloc = FPZIPAlloc;
+			context.dealloc = FPZIPFree;
+			context.error = fpzipSuccess;
+			context._this = IO;
+		}
+
+		const unsigned long PointCount = Count / 3u;
+
+		FPZ* fpz = fpzip_read_from_buffer_ctx(&context, Src);
+		fpz->type = bFloatInRange ? FPZIP_TYPE_FLOAT : FPZIP_TYPE_DOUBLE;
+		fpz->nx = static_cast<decltype(fpz->nx)>(bPlanar ? PointCount : Count);
+		fpz->ny = 1;
+		fpz->nz = 1;
+		fpz->nf = bPlanar ? 3 : 1;
+
+		// planar fields are decoded aside and interleaved afterwards, as are doubles that don't fit in Dest
+		const bool bNarrow = !bFloatInRange && (sizeof(U) < sizeof(double));
+		void* Data = (bPlanar || bNarrow) ? Scratch : static_cast<void*>(Dest);
+		fpzip_read(fpz, Data);
+
+		fpzip_read_close(fpz);
+
+		if (context.error != fpzipSuccess)
+		{
+			return context.error;
+		}
+
+		if (bPlanar)
+		{
+			// interleaves as it goes
+			if (bFloatInRange)
+			{
+				TransformPlanar(Transform, reinterpret_cast<const float*>(Data), PointCount, Dest);
+			}
+			else
+			{
+				TransformPlanar(Transform, reinterpret_cast<const double*>(Data), PointCount, Dest);
+			}
+		}
+		else if (bNarrow)
+		{
+			TransformInterleaved(Transform, reinterpret_cast<const double*>(Data), Dest, Count);
+		}
+		else if (bFloatInRange && (sizeof(U) > sizeof(float)))
+		{
+			// widen in place from the back, the floats fill the first half
+			const float* Src32 = reinterpret_cast<const float*>(Dest) + Count - 1u;
+			U* Dest64 = Dest + Count - 1u;
+			for (unsigned long i = 0u; i < Count; ++i, --Src32, --Dest64)
+			{
+				(*Dest64) = static_cast<U>(*Src32);
+			}
+
+			if (Transform)
+			{
+				TransformInterleaved(Transform, Dest, Dest, PointCount * 3u);
+			}
+		}
+		else if (Transform)
+		{
+			// already in Dest's own type
+			TransformInterleaved(Transform, Dest, Dest, PointCount * 3u);
+		}
+
+		return fpzipSuccess;
+	}
+
+	// calls Func(i) for every i below Count, spread over ThreadCount threads including the calling one
+	template<typename FUNC>
+	static void ParallelFor(unsigned long long Count, unsigned long long ThreadCount, FUNC&& Func)
+	{
+		ThreadCount = std::min(ThreadCount, Count);
+
+		std::atomic<unsigned long long> Next(0u);
+		auto Worker = [&]()
+		{
+			for (unsigned long long i = Next++; i < Count; i = Next++)
+			{
+				Func(i);
+			}
+		};
+
+		if (ThreadCount <= 1u)
+		{
+			Worker();
+			return;
+		}
+
+		std::unique_ptr<std::thread[]> Threads(new std::thread[ThreadCount - 1u]);
+		for (unsigned long long i = 0u; i < (ThreadCount - 1u); ++i)
+		{
+			Threads[i] = std::thread(Worker);
+		}
+		Worker();
+		for (unsigned long long i = 0u; i < (ThreadCount - 1u); ++i)
+		{
+			Threads[i].join();
+		}
+	}
+	
+
+	struct ISzAllocForGeometry : public ISzAlloc
+	{
+		CustomIO* _this;
+	};
+	static void* LZMAAlloc(ISzAllocPtr raw, size_t size)
+	{
+		return CurGeometryIOProcessorAlloc(static_cast<const ISzAllocForGeometry*>(raw)->_this, size);
+	}
+	static void LZMAFree(ISzAllocPtr raw, void* address)
+	{
+		return CurGeometryIOProcessorFree(static_cast<const ISzAllocForGeometry*>(raw)->_this, address);
+	}
+
+
+	// fills everything but the lzma2 block threading and returns the thread count to encode SrcLen bytes with
+	static unsigned long SetupLZMAProps(const GeometryWriter::EncodeOptions& Options, unsigned long long SrcLen, CLzmaEncProps* Props)
+	{
+		LzmaEncProps_Init(Props);
+		Props->level = Options.Level;
+		Props->lc = Options.LiteralContextBits;
+		Props->lp = Options.LiteralPositionBits;
+		Props->pb = Options.PositionBits;
+		Props->fb = Options.FastBytes;
+		switch (Options.MatchFinder)
+		{
+		case GeometryWriter::EncodeOptions::MATCHFINDER_HC4:
+			Props->algo = 0;
+			Props->btMode = 0;
+			Props->numHashBytes = 4;
+			break;
+		case GeometryWriter::EncodeOptions::MATCHFINDER_HC5:
+			Props->algo = 0;
+			Props->btMode = 0;
+			Props->numHashBytes = 5;
+			break;
+		case GeometryWriter::EncodeOptions::MATCHFINDER_BT2:
+			Props->algo = 1;
+			Props->btMode = 1;
+			Props->numHashBytes = 2;
+			break;
+		case GeometryWriter::EncodeOptions::MATCHFINDER_BT3:
+			Props->algo = 1;
+			Props->btMode = 1;
+			Props->numHashBytes = 3;
+			break;
+		default:
+			Props->algo = 1;
+			Props->btMode = 1;
+			Props->numHashBytes = 4;
+			break;
+		}
+
+		// grows in powers of two so that payloads of similar size keep reusing the same match finder tables
+		UInt32 DictSize = Options.DictSize;
+		if (DictSize == 0u)
+		{
+			const UInt32 Limit = LzmaEncProps_GetDictSize(Props);
+
+			DictSize = (1u << 12u);
+			while ((DictSize < Limit) && (DictSize < SrcLen))
+			{
+				DictSize <<= 1u;
+			}
+			DictSize = std::min(DictSize, Limit);
+		}
+		Props->dictSize = DictSize;
+		// keeps lzma from trimming the dictionary down to the exact payload size
+		Props->reduceSize = std::max<unsigned long long>(SrcLen, DictSize);
+
+		unsigned long ThreadCount = Options.ThreadCount;
+		if (ThreadCount == 0u)
+		{
+			ThreadCount = std::max(std::thread::hardware_concurrency(), 1u);
+		}
+		if (SrcLen < (1u << 18u))
+		{
+			ThreadCount = 1u;
+		}
+		Props->numThreads = (ThreadCount > 1u) ? 2 : 1;
+
+		return ThreadCount;
+	}
+
+
+#ifdef USE_LZMA2
+	struct LZMA2EncoderState
+	{
+		ISzAllocForGeometry allocator;
+		CLzma2EncHandle handle;
+	};
+
+	struct LZMA2DecoderState
+	{
+		ISzAllocForGeometry allocator;
+		CLzma2Dec dec;
+		Byte prop;
+	};
+
+	struct LZMA2InStream : public ISeqInStream
+	{
+		const Byte* Cur;
+		SizeT Remain;
+	};
+	static SRes LZMA2InStreamRead(const ISeqInStream* raw, void* buf, size_t* size)
+	{
+		LZMA2InStream* Stream = const_cast<LZMA2InStream*>(static_cast<const LZMA2InStream*>(raw));
+
+		const size_t Len = std::min<size_t>(*size, Stream->Remain);
+		Memcpy(buf, Stream->Cur, Len);
+		Stream->Cur += Len;
+		Stream->Remain -= Len;
+
+		(*size) = Len;
+		return SZ_OK;
+	}
+	
+	struct LZMA2OutStream : public ISeqOutStream
+	{
+		Byte* Cur;
+		SizeT Remain;
+	};
+	static size_t LZMA2OutStreamWrite(const ISeqOutStream* raw, const void* buf, size_t size)
+	{
+		LZMA2OutStream* Stream = const_cast<LZMA2OutStream*>(static_cast<const LZMA2OutStream*>(raw));
+
+		const size_t Len = std::min<size_t>(size, Stream->Remain);
+		Memcpy(Stream->Cur, buf, Len);
+		Stream->Cur += Len;
+		Stream->Remain -= Len;
+
+		return Len;
+	}
+#endif
+
+
+	// byte oriented lz77 built for decode speed. every sequence is
+	// [token: literal run << 4 | match length - 4][literal run extension][literals][offset u16][match length extension]
+	// runs of 15 or more continue in extension bytes of up to 255 each. the last sequence has literals only
+	static const unsigned long LZMinMatch = 4u;
+	static const unsigned long LZMaxOffset = 0xFFFFu;
+	
+	static unsigned long long LZCompressBound(unsigned long long SrcLen)
+	{
+		return SrcLen + (SrcLen / 255u) + 16u;
+	}
+	static unsigned long LZTableBits(unsigned long long SrcLen)
+	{
+		unsigned long Bits = 10u;
+		while ((Bits < 16u) && ((1ull << Bits) < SrcLen))
+		{
+			++Bits;
+		}
+		return Bits;
+	}
+	
+	static unsigned char* LZWriteLength(unsigned char* Op, unsigned long long Len)
+	{
+		for (; Len >= 255u; Len -= 255u)
+		{
+			*(Op++) = 255u;
+		}
+		*(Op++) = static_cast<unsigned char>(Len);
+		return Op;
+	}
+	static unsigned char* LZWriteSequence(unsigned char* Op, const unsigned char* Literals, unsigned long long LiteralLen, unsigned long Offset, unsigned long long MatchLen)
+	{
+		unsigned char* Token = Op++;
+
+		if (LiteralLen >= 15u)
+		{
+			(*Token) = 0xF0;
+			Op = LZWriteLength(Op, LiteralLen - 15u);
+		}
+		else
+		{
+			(*Token) = static_cast<unsigned char>(LiteralLen << 4u);
+		}
+		MemcpyAndMove(Op, Literals, LiteralLen);
+
+		if (MatchLen > 0u)
+		{
+			*(Op++) = static_cast<unsigned char>(Offset & 0xFF);
+			*(Op++) = static_cast<unsigned char>(Offset >> 8u);
+
+			MatchLen -= LZMinMatch;
+			if (MatchLen >= 15u)
+			{
+				(*Token) |= 0x0F;
+				Op = LZWriteLength(Op, MatchLen - 15u);
+			}
+			else
+			{
+				(*Token) |= static_cast<unsigned char>(MatchLen);
+			}
+		}
+
+		return Op;
+	}
+	
+	// Table holds (1 << TableBits) zeroed entries. returns the compressed size
+	static unsigned long long LZCompress(const unsigned char* Src, unsigned long long SrcLen, unsigned char* Dest, unsigned long* Table, unsigned long TableBits)
+	{
+		const unsigned char* Ip = Src;
+		const unsigned char* Anchor = Src;
+		const unsigned char* const End = Src + SrcLen;
+		unsigned char* Op = Dest;
+
+		if (SrcLen > 12u)
+		{
+			// matches never reach into the last 5 bytes and never start within the last 12
+			const unsigned char* const MatchLimit = End - 5u;
+			const unsigned char* const SearchLimit = End - 12u;
+			const unsigned long Shift = 32u - TableBits;
+
+			auto Read32 = [](const unsigned char* Ptr)
+			{
+				unsigned long V;
+				Memcpy(&V, Ptr, 4u);
+				return V;
+			};
+			auto Read64 = [](const unsigned char* Ptr)
+			{
+				unsigned long long V;
+				Memcpy(&V, Ptr, 8u);
+				return V;
+			};
+			auto Hash = [Shift](unsigned long V)
+			{
+				return static_cast<unsigned long>((V * 2654435761u) & 0xFFFFFFFF) >> Shift;
+			};
+
+			while (Ip < SearchLimit)
+			{
+				const unsigned long Seq = Read32(Ip);
+				const unsigned long Slot = Hash(Seq);
+				
+				// positions are kept modulo 2^32, the distance check and the byte compare below reject anything stale
+				const unsigned long Pos = static_cast<unsigned long>(Ip - Src);
+				const unsigned long Offset = (Pos - Table[Slot]) & 0xFFFFFFFF;
+				Table[Slot] = Pos;
+
+				if ((Offset == 0u) || (Offset > LZMaxOffset) || (Offset > static_cast<unsigned long long>(Ip - Src)) || (Read32(Ip - Offset) != Seq))
+				{
+					// step faster through data that doesn't match
+					Ip += 1u + (static_cast<unsigned long long>(Ip - Anchor) >> 6u);
+					continue;
+				}
+
+				const unsigned char* Match = Ip - Offset;
+				while ((Ip > Anchor) && (Match > Src) && (Ip[-1] == Match[-1]))
+				{
+					--Ip;
+					--Match;
+				}
+
+				const unsigned char* MatchEnd = Ip + LZMinMatch;
+				Match += LZMinMatch;
+				while (((MatchEnd + 8u) <= MatchLimit) && (Read64(MatchEnd) == Read64(Match)))
+				{
+					MatchEnd += 8u;
+					Match += 8u;
+				}
+				while ((MatchEnd < MatchLimit) && ((*MatchEnd) == (*Match)))
+				{
+					++MatchEnd;
+					++Match;
+				}
+
+				Op = LZWriteSequence(Op, Anchor, Ip - Anchor, Offset, MatchEnd - Ip);
+
+				Ip = MatchEnd;
+				Anchor = Ip;
+				
+				Table[Hash(Read32(Ip - 2u))] = static_cast<unsigned long>(Ip - 2u - Src);
+			}
+		}
+
+		Op = LZWriteSequence(Op, Anchor, End - Anchor, 0u, 0u);
+
+		return static_cast<unsigned long long>(Op - Dest);
+	}
+	
+	// fails on corrupted input instead of reading or writing out of bounds
+	static bool LZDecompress(const unsigned char* Src, unsigned long long SrcLen, unsigned char* Dest, unsigned long long DestCapacity, unsigned long long* DestLen)
+	{
+		const unsigned char* Ip = Src;
+		const unsigned char* const IEnd = Src + SrcLen;
+		unsigned char* Op = Dest;
+		unsigned char* const OEnd = Dest + DestCapacity;
+
+		auto ReadLength = [&Ip, IEnd](unsigned long long* Len)
+		{
+			for (;;)
+			{
+				if (Ip >= IEnd)
+				{
+					return false;
+				}
+				const unsigned char V = *(Ip++);
+				(*Len) += V;
+				if (V != 255u)
+				{
+					return true;
+				}
+			}
+		};
+
+		for (;;)
+		{
+			if (Ip >= IEnd)
+			{
+				return false;
+			}
+			const unsigned char Token = *(Ip++);
+
+			unsigned long long LiteralLen = Token >> 4u;
+			if ((LiteralLen == 15u) && !ReadLength(&LiteralLen))
+			{
+				return false;
+			}
+			if ((LiteralLen > static_cast<unsigned long long>(IEnd - Ip)) || (LiteralLen > static_cast<unsigned long long>(OEnd - Op)))
+			{
+				return false;
+			}
+			Memcpy(Op, Ip, LiteralLen);
+			Op += LiteralLen;
+			Ip += LiteralLen;
+
+			if (Ip == IEnd)
+			{
+				break;
+			}
+
+			if ((IEnd - Ip) < 2)
+			{
+				return false;
+			}
+			const unsigned long Offset = static_cast<unsigned long>(Ip[0]) | (static_cast<unsigned long>(Ip[1]) << 8u);
+			Ip += 2u;
+
+			unsigned long long MatchLen = Token & 0x0F;
+			if ((MatchLen == 15u) && !ReadLength(&MatchLen))
+			{
+				return false;
+			}
+			MatchLen += LZMinMatch;
+
+			if ((Offset == 0u) || (Offset > static_cast<unsigned long long>(Op - Dest)) || (MatchLen > static_cast<unsigned long long>(OEnd - Op)))
+			{
+				return false;
+			}
+
+			const unsigned char* Match = Op - Offset;
+			if (Offset < 8u)
+			{
+				for (unsigned char* const MatchEnd = Op + MatchLen; Op != MatchEnd; ++Op, ++Match)
+				{
+					(*Op) = (*Match);
+				}
+			}
+			else
+			{
+				// a run shorter than its offset is one plain copy, a longer one repeats the last Offset bytes
+				while (MatchLen > 0u)
+				{
+					const unsigned long long Len = std::min<unsigned long long>(MatchLen, Offset);
+					Memcpy(Op, Match, Len);
+					Op += Len;
+					Match += Len;
+					MatchLen -= Len;
+				}
+			}
+		}
+
+		(*DestLen) = static_cast<unsigned long long>(Op - Dest);
+		return true;
+	}
+
+
+	// triangle connectivity coding. each triangle starts with a byte
+	// 0x80 | rotation << 4 | edge : the triangle rotated by rotation shares edge (an age into the edge fifo) reversed, the third vertex follows as a vertex code
+	// 0xC0 | rotation << 4 | edge : same, and the third vertex is the next unseen one
+	// 0x00                        : three vertex codes follow
+	// a vertex code is a varint of 0 for the next unseen vertex, 1 + age for a vertex fifo hit, or 17 + zigzag delta from the previous vertex.
+	// indices past the last whole triangle are plain vertex codes
+	struct TriangleCodecState
+	{
+		unsigned long Edges[16][2];
+		unsigned long Verts[16];
+		unsigned long EdgeHead;
+		unsigned long VertHead;
+
+		// one past the highest vertex seen so far
+		unsigned long long Next;
+		unsigned long Last;
+	};
+	
+	static void TriangleCodecInit(TriangleCodecState* State)
+	{
+		Memset(&State->Edges[0][0], static_cast<unsigned long>(-1), sizeof(State->Edges));
+		Memset(State->Verts, static_cast<unsigned long>(-1), sizeof(State->Verts));
+		State->EdgeHead = 0u;
+		State->VertHead = 0u;
+		State->Next = 0u;
+		State->Last = 0u;
+	}
+	static void TriangleCodecPushEdge(TriangleCodecState* State, unsigned long A, unsigned long B)
+	{
+		unsigned long* Edge = State->Edges[(State->EdgeHead++) & 15u];
+		Edge[0] = A;
+		Edge[1] = B;
+	}
+	static const unsigned long* TriangleCodecEdge(const TriangleCodecState* State, unsigned long Age)
+	{
+		return State->Edges[(State->EdgeHead - 1u - Age) & 15u];
+	}
+	static void TriangleCodecVisit(TriangleCodecState* State, unsigned long V, bool bFifoHit)
+	{
+		if (!bFifoHit)
+		{
+			State->Verts[(State->VertHead++) & 15u] = V;
+		}
+		State->Next = std::max<unsigned long long>(State->Next, static_cast<unsigned long long>(V) + 1u);
+		State->Last = V;
+	}
+	
+	static unsigned char* WriteVarint(unsigned char* Op, unsigned long long V)
+	{
+		for (; V >= 0x80; V >>= 7u)
+		{
+			*(Op++) = static_cast<unsigned char>(V | 0x80);
+		}
+		*(Op++) = static_cast<unsigned char>(V);
+		return Op;
+	}
+	static bool ReadVarint(const unsigned char*& Ip, const unsigned char* IEnd, unsigned long long* V)
+	{
+		(*V) = 0u;
+		for (unsigned long Shift = 0u; Shift < 64u; Shift += 7u)
+		{
+			if (Ip >= IEnd)
+			{
+				return false;
+			}
+			const unsigned char Byte = *(Ip++);
+			(*V) |= static_cast<unsigned long long>(Byte & 0x7F) << Shift;
+			if ((Byte & 0x80) == 0u)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+	
+	static unsigned char* WriteVertexCode(TriangleCodecState* State, unsigned char* Op, unsigned long V)
+	{
+		if (V == State->Next)
+		{
+			TriangleCodecVisit(State, V, false);
+			return WriteVarint(Op, 0u);
+		}
+		for (unsigned long Age = 0u; Age < 16u; ++Age)
+		{
+			if (State->Verts[(State->VertHead - 1u - Age) & 15u] == V)
+			{
+				TriangleCodecVisit(State, V, true);
+				return WriteVarint(Op, 1u + Age);
+			}
+		}
+
+		const long long Delta = static_cast<long long>(V) - static_cast<long long>(State->Last);
+		const unsigned long long ZigZag = (static_cast<unsigned long long>(Delta) << 1u) ^ static_cast<unsigned long long>(Delta >> 63u);
+		TriangleCodecVisit(State, V, false);
+		return WriteVarint(Op, 17u + ZigZag);
+	}
+	static bool ReadVertexCode(TriangleCodecState* State, const unsigned char*& Ip, const unsigned char* IEnd, unsigned long* V)
+	{
+		unsigned long long Code;
+		if (!ReadVarint(Ip, IEnd, &Code))
+		{
+			return false;
+		}
+
+		bool bFifoHit = false;
+		unsigned long long Result;
+		if (Code == 0u)
+		{
+			Result = State->Next;
+		}
+		else if (Code <= 16u)
+		{
+			Result = State->Verts[(State->VertHead - Code) & 15u];
+			bFifoHit = true;
+		}
+		else
+		{
+			const unsigned long long ZigZag = Code - 17u;
+			const long long Delta = static_cast<long long>(ZigZag >> 1u) ^ -static_cast<long long>(ZigZag & 1u);
+			Result = static_cast<unsigned long long>(static_cast<long long>(State->Last) + Delta);
+		}
+		if (Result > 0xFFFFFFFF)
+		{
+			return false;
+		}
+
+		(*V) = static_cast<unsigned long>(Result);
+		TriangleCodecVisit(State, *V, bFifoHit);
+		return true;
+	}
+
+
+#ifdef USE_BMI2
+	static bool HasFastBMI2()
+	{
+		static const bool bSupported = []()
+		{
+			Cx86cpuid p;
+			if (!x86cpuid_CheckAndRead(&p) || (p.maxFunc < 7u))
+			{
+				return false;
+			}
+
+			UInt32 d[4] = { 0u };
+			MyCPUID(7u, &d[0], &d[1], &d[2], &d[3]);
+			if (((d[1] >> 8u) & 1u) == 0u)
+			{
+				return false;
+			}
+
+			// pdep/pext are microcoded before zen3 and lose to plain shifts there. x86cpuid_GetFamily packs the extended family above the
+			// base one, so the display family (base plus extended when base is 0xF) is taken apart by hand: 0x17 for zen1/2, 0x19 for zen3
+			if (x86cpuid_GetFirm(&p) == CPU_FIRM_AMD)
+			{
+				const UInt32 BaseFamily = (p.ver >> 8u) & 0xFu;
+				const UInt32 Family = (BaseFamily == 0xFu) ? (BaseFamily + ((p.ver >> 20u) & 0xFFu)) : BaseFamily;
+				if (Family < 0x19u)
+				{
+					return false;
+				}
+			}
+
+			return true;
+		}();
+		return bSupported;
+	}
+
+	// two 4 byte indices per step. Bits must not exceed 16 so a pair always fits next to the pending bits
+	TARGET_BMI2 static const unsigned long* PackIndsBMI2(unsigned long Bits, const unsigned long* Src, const unsigned long* SrcEnd, unsigned char** Dest, unsigned long long* Acc, unsigned long* AccBits)
+	{
+		const unsigned long long Mask = (1ull << Bits) - 1u;
+		const unsigned long long PairMask = Mask | (Mask << 32u);
+
+		unsigned char* Op = *Dest;
+		unsigned long long CurAcc = *Acc;
+		unsigned long CurAccBits = *AccBits;
+		for (; (SrcEnd - Src) >= 2; Src += 2)
+		{
+			unsigned long long Pair;
+			Memcpy(&Pair, Src, 8u);
+
+			CurAcc |= static_cast<unsigned long long>(_pext_u64(Pair, PairMask)) << CurAccBits;
+			CurAccBits += Bits << 1u;
+			if (CurAccBits >= 32u)
+			{
+				MemcpyAndMove(Op, &CurAcc, 4u);
+				CurAcc >>= 32u;
+				CurAccBits -= 32u;
+			}
+		}
+		(*Dest) = Op;
+		(*Acc) = CurAcc;
+		(*AccBits) = CurAccBits;
+
+		return Src;
+	}
+
+	// two 4 byte indices per step while a whole 8 byte window is left. Bits must not exceed 28. returns how many were written
+	TARGET_BMI2 static unsigned long long UnpackIndsBMI2(unsigned long Bits, unsigned long long Count, const unsigned char* In, unsigned long long InLen, unsigned long* Out)
+	{
+		const unsigned long long Mask = (1ull << Bits) - 1u;
+		const unsigned long long PairMask = Mask | (Mask << 32u);
+
+		unsigned long long i = 0u;
+		for (; (i + 2u) <= Count; i += 2u)
+		{
+			const unsigned long long BitOffset = i * Bits;
+			if (((BitOffset >> 3u) + 8u) > InLen)
+			{
+				break;
+			}
+
+			unsigned long long Window;
+			Memcpy(&Window, In + (BitOffset >> 3u), 8u);
+
+			const unsigned long long Pair = _pdep_u64(Window >> (BitOffset & 7u), PairMask);
+			Memcpy(Out + i, &Pair, 8u);
+		}
+
+		return i;
+	}
+#endif
+
+
+	static void SetErrorMsg(const char* Prefix, const char* Msg, TempBuffer<char>* Buffer)
+	{
+		const unsigned long long PrefixLen = strlen(Prefix);
+		const unsigned long long MsgLen = strlen(Msg);
+		const unsigned long long TotalLen = PrefixLen + MsgLen + 1;
+		Buffer->Resize(TotalLen);
+		Memcpy(Buffer->Get(), Prefix, PrefixLen);
+		Memcpy(Buffer->Get() + PrefixLen, Msg, MsgLen);
+		*(Buffer->Get() + (TotalLen - 1)) = 0u;
+	}
+
+	static void FPZIPGetErrorMsg(fpzipError Err, TempBuffer<char>* Buffer)
+	{
+		SetErrorMsg(ERRPrefixFPZIP, fpzip_errstr[Err], Buffer);
+	}
+	
+	static void LZMAGetErrorMsg(SRes Err, TempBuffer<char>* Buffer)
+	{
+		const char* Msg;
+		switch(Err)
+		{
+		case SZ_ERROR_DATA:
+			Msg = MAKE_TEXT(SZ_ERROR_DATA);
+			break;
+		case SZ_ERROR_MEM:
+			Msg = MAKE_TEXT(SZ_ERROR_MEM);
+			break;
+		case SZ_ERROR_CRC:
+			Msg = MAKE_TEXT(SZ_ERROR_CRC);
+			break;
+		case SZ_ERROR_UNSUPPORTED:
+			Msg = MAKE_TEXT(SZ_ERROR_UNSUPPORTED);
+			break;
+		case SZ_ERROR_PARAM:
+			Msg = MAKE_TEXT(SZ_ERROR_PARAM);
+			break;
+		case SZ_ERROR_INPUT_EOF:
+			Msg = MAKE_TEXT(SZ_ERROR_INPUT_EOF);
+			break;
+		case SZ_ERROR_OUTPUT_EOF:
+			Msg = MAKE_TEXT(SZ_ERROR_OUTPUT_EOF);
+			break;
+		case SZ_ERROR_READ:
+			Msg = MAKE_TEXT(SZ_ERROR_READ);
+			break;
+		case SZ_ERROR_WRITE:
+			Msg = MAKE_TEXT(SZ_ERROR_WRITE);
+			break;
+		case SZ_ERROR_PROGRESS:
+			Msg = MAKE_TEXT(SZ_ERROR_PROGRESS);
+			break;
+		case SZ_ERROR_FAIL:
+			Msg = MAKE_TEXT(SZ_ERROR_FAIL);
+			break;
+		case SZ_ERROR_THREAD:
+			Msg = MAKE_TEXT(SZ_ERROR_THREAD);
+			break;
+
+		case SZ_ERROR_ARCHIVE:
+			Msg = MAKE_TEXT(SZ_ERROR_ARCHIVE);
+			break;
+		case SZ_ERROR_NO_ARCHIVE:
+			Msg = MAKE_TEXT(SZ_ERROR_NO_ARCHIVE);
+			break;
+
+		default:
+			Msg = "";
+			break;
+		}
+
+		SetErrorMsg(ERRPrefixLZMA, Msg, Buffer);
+	}
+
+
+	static unsigned long long HashName(const wchar_t* Name)
+	{
+		// FNV-1a
+		unsigned long long Hash = 14695981039346656037ull;
+		for (; (*Name) != 0; ++Name)
+		{
+			Hash ^= static_cast<unsigned long long>(*Name);
+			Hash *= 1099511628211ull;
+		}
+		return Hash;
+	}
+
+	// open addressing table of geometry indices, power of two sized and at most half full. names are inserted in order, so duplicated names resolve to the first geometry
+	template<typename FUNC>
+	static void BuildNameTable(unsigned long long GeometryCount, FUNC&& GetName, TempBuffer<unsigned long>* Table)
+	{
+		unsigned long long BucketCount = 0u;
+		if (GeometryCount > 0u)
+		{
+			for (BucketCount = 1u; BucketCount < (GeometryCount << 1u); BucketCount <<= 1u);
+		}
+
+		Table->Resize(BucketCount, static_cast<unsigned long>(-1));
+
+		const unsigned long long Mask = BucketCount - 1u;
+		for (unsigned long long i = 0u; i < GeometryCount; ++i)
+		{
+			unsigned long long Bucket = HashName(GetName(i)) & Mask;
+			while ((*Table)[Bucket] != static_cast<unsigned long>(-1))
+			{
+				Bucket = (Bucket + 1u) & Mask;
+			}
+			(*Table)[Bucket] = static_cast<unsigned long>(i);
+		}
+	}
+	// whether a stored table has the shape BuildNameTable gives it, so that probing it always ends on an empty bucket within range
+	static bool CheckNameTable(const unsigned long* Table, unsigned long long BucketCount, unsigned long long GeometryCount)
+	{
+		if (((BucketCount & (BucketCount - 1u)) != 0u) || (BucketCount < (GeometryCount << 1u)))
+		{
+			return false;
+		}
+
+		bool bHasEmpty = (BucketCount == 0u);
+		for (unsigned long long i = 0u; i < BucketCount; ++i)
+		{
+			if (Table[i] == static_cast<unsigned long>(-1))
+			{
+				bHasEmpty = true;
+			}
+			else if (Table[i] >= GeometryCount)
+			{
+				return false;
+			}
+		}
+		return bHasEmpty;
+	}
+
+
+	// records where each of the null terminated names starts and returns the end of the last one, or null when the names overrun PtrEnd
+	static const wchar_t* ScanNames(const wchar_t* Ptr, const wchar_t* PtrEnd, unsigned long long GeometryCount, const wchar_t** Names)
+	{
+		for (unsigned long long i = 0u; i < GeometryCount; ++i)
+		{
+			Names[i] = Ptr;
+			for (; (Ptr != PtrEnd) && ((*Ptr) != 0); ++Ptr);
+			if (Ptr == PtrEnd)
+			{
+				return nullptr;
+			}
+			++Ptr;
+		}
+		return Ptr;
+	}
+
+	// header tables are used in place when suitably aligned, otherwise they are copied into the given buffer
+	template<typename T>
+	static const T* InPlaceOrCopy(const unsigned char* Ptr, unsigned long long Count, TempBuffer<T>* Buffer)
+	{
+		if ((reinterpret_cast<unsigned long long>(Ptr) % alignof(T)) == 0u)
+		{
+			return reinterpret_cast<const T*>(Ptr);
+		}
+
+		Buffer->Resize(Count);
+		Memcpy(Buffer->Get(), Ptr, Count * sizeof(T));
+		return Buffer->Get();
+	}
+
+
+	static double Abs64(double V)
+	{
+		unsigned long long* CurBitsPtr = reinterpret_cast<unsigned long long*>(&V);
+		unsigned long long CurBits = *CurBitsPtr;
+		CurBits <<= 1u;
+		CurBits >>= 1u;
+		(*CurBitsPtr) = CurBits;
+		return V;
+	}
+	static float Abs32(float V)
+	{
+		unsigned long* CurBitsPtr = reinterpret_cast<unsigned long*>(&V);
+		unsigned long CurBits = *CurBitsPtr;
+		CurBits <<= 1u;
+		CurBits >>= 1u;
+		(*CurBitsPtr) = CurBits;
+		return V;
+	}
+	
+	
+	static double Rsqrt64_base(double V)
+	{
+		double X2 = V * 0.5;
+		double Y = V;
+		unsigned long long I = *reinterpret_cast<unsigned long long*>(&Y);
+		I = 0x5fe6eb50c7b537a9 - (I >> 1);
+		Y = *reinterpret_cast<double*>(&I);
+		Y = Y * (1.5 - (X2 * Y * Y));
+		return Y;
+	}
+	static float Rsqrt32_base(float V)
+	{
+		float X2 = V * 0.5f;
+		float Y = V;
+		unsigned long I = *reinterpret_cast<unsigned long*>(&Y);
+		I = 0x5F3759DF - (I >> 1);
+		Y = *reinterpret_cast<float*>(&I);
+		Y = Y * (1.5f - (X2 * Y * Y));
+		return Y;
+	}
+	
+	static double Rsqrt64(double V)
+	{
+		double X2 = V * 0.5;
+		double Y = Rsqrt64_base(V);
+
+		// more newton iteration for accuracy
+		Y = Y * (1.5 - (X2 * Y * Y));
+		Y = Y * (1.5 - (X2 * Y * Y));
+
+		return Y;
+	}
+	static float Rsqrt32(float V)
+	{
+		float X2 = V * 0.5f;
+		float Y = Rsqrt32_base(V);
+
+		// more newton iteration for accuracy
+		Y = Y * (1.5f - (X2 * Y * Y));
+		Y = Y * (1.5f - (X2 * Y * Y));
+
+		return Y;
+	}
+	
+	static double Sqrt64(double V)
+	{
+		double Y = 1. / Rsqrt64(V);
+
+		return Y;
+	}
+	static float Sqrt32(float V)
+	{
+		float Y = 1.f / Rsqrt32(V);
+
+		return Y;
+	}
+
+	// every coordinate has to sit in float range and apart from its float
+	static bool CoordsFitFloat(const double* Src, unsigned long long Count)
+	{
+		for (const double *i = Src, *e = Src + Count; i != e; ++i)
+		{
+			const double CurValue64 = Abs64(*i);
+			if (CurValue64 <= FLT_MIN)
+			{
+				return false;
+			}
+			else if (CurValue64 >= 8796093022208.0)
+			{
+				return false;
+			}
+
+			const float CurValue32 = static_cast<float>(CurValue64);
+
+			const double Diff = Abs64(CurValue64 - CurValue32);
+			if (Diff <= FLT_EPSILON)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+	// and so does the area of every triangle
+	static bool TrianglesFitFloat(const double* Verts, const unsigned long* Inds, unsigned long long TriCount)
+	{
+		for (const unsigned long *i = Inds, *e = Inds + (TriCount * 3u); i != e; i += 3u)
+		{
+			double Magnitude64;
+			{
+				double _0X, _0Y, _0Z;
+				{
+					const double* Ptr = Verts + ((*i) * 3u);
+
+					_0X = *Ptr;
+					_0Y = *(Ptr + 1u);
+					_0Z = *(Ptr + 2u);
+				}
+
+				double _1X, _1Y, _1Z;
+				{
+					const double* Ptr = Verts + ((*(i + 1u)) * 3u);
+
+					_1X = *Ptr;
+					_1Y = *(Ptr + 1u);
+					_1Z = *(Ptr + 2u);
+				}
+
+				double _2X, _2Y, _2Z;
+				{
+					const double* Ptr = Verts + ((*(i + 2u)) * 3u);
+
+					_2X = *Ptr;
+					_2Y = *(Ptr + 1u);
+					_2Z = *(Ptr + 2u);
+				}
+
+				const double d0X = _1X - _0X;
+				const double d0Y = _1Y - _0Y;
+				const double d0Z = _1Z - _0Z;
+
+				const double d1X = _2X - _0X;
+				const double d1Y = _2Y - _0Y;
+				const double d1Z = _2Z - _0Z;
+
+				const double cX = d0Y * d1Z - d0Z * d1Y;
+				const double cY = d0Z * d1X - d0X * d1Z;
+				const double cZ = d0X * d1Y - d0Y * d1X;
+
+				double Magnitude = cX * cX + cY * cY + cZ * cZ;
+				Magnitude = Sqrt64(Magnitude);
+				Magnitude *= 0.5;
+
+				if (Magnitude <= FLT_MIN)
+				{
+					return false;
+				}
+				else if (Magnitude >= 8796093022208.0)
+				{
+					return false;
+				}
+
+				Magnitude64 = Magnitude;
+			}
+
+			float Magnitude32;
+			{
+				float _0X, _0Y, _0Z;
+				{
+					const double* Ptr = Verts + ((*i) * 3u);
+
+					_0X = static_cast<float>(*Ptr);
+					_0Y = static_cast<float>(*(Ptr + 1u));
+					_0Z = static_cast<float>(*(Ptr + 2u));
+				}
+
+				float _1X, _1Y, _1Z;
+				{
+					const double* Ptr = Verts + ((*(i + 1u)) * 3u);
+
+					_1X = static_cast<float>(*Ptr);
+					_1Y = static_cast<float>(*(Ptr + 1u));
+					_1Z = static_cast<float>(*(Ptr + 2u));
+				}
+
+				float _2X, _2Y, _2Z;
+				{
+					const double* Ptr = Verts + ((*(i + 2u)) * 3u);
+
+					_2X = static_cast<float>(*Ptr);
+					_2Y = static_cast<float>(*(Ptr + 1u));
+					_2Z = static_cast<float>(*(Ptr + 2u));
+				}
+
+				const float d0X = _1X - _0X;
+				const float d0Y = _1Y - _0Y;
+				const float d0Z = _1Z - _0Z;
+
+				const float d1X = _2X - _0X;
+				const float d1Y = _2Y - _0Y;
+				const float d1Z = _2Z - _0Z;
+
+				const float cX = d0Y * d1Z - d0Z * d1Y;
+				const float cY = d0Z * d1X - d0X * d1Z;
+				const float cZ = d0X * d1Y - d0Y * d1X;
+
+				float Magnitude = cX * cX + cY * cY + cZ * cZ;
+				Magnitude = Sqrt32(Magnitude);
+				Magnitude *= 0.5f;
+
+				Magnitude32 = Magnitude;
+			}
+
+			const double Diff = Abs64(Magnitude64 - Magnitude32);
+			if (Diff <= FLT_EPSILON)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+#ifdef USE_SSE2
+	static __m128d Rsqrt64SSE2(__m128d V)
+	{
+		// Rsqrt64 lane by lane, with the same operations in the same order
+		const __m128d Half = _mm_set1_pd(0.5);
+		const __m128d ThreeHalves = _mm_set1_pd(1.5);
+
+		const __m128d X2 = _mm_mul_pd(V, Half);
+		__m128d Y = _mm_castsi128_pd(_mm_sub_epi64(_mm_set1_epi64x(0x5fe6eb50c7b537a9), _mm_srli_epi64(_mm_castpd_si128(V), 1)));
+		Y = _mm_mul_pd(Y, _mm_sub_pd(ThreeHalves, _mm_mul_pd(_mm_mul_pd(X2, Y), Y)));
+		Y = _mm_mul_pd(Y, _mm_sub_pd(ThreeHalves, _mm_mul_pd(_mm_mul_pd(X2, Y), Y)));
+		Y = _mm_mul_pd(Y, _mm_sub_pd(ThreeHalves, _mm_mul_pd(_mm_mul_pd(X2, Y), Y)));
+		return Y;
+	}
+	static __m128 Rsqrt32SSE2(__m128 V)
+	{
+		const __m128 Half = _mm_set1_ps(0.5f);
+		const __m128 ThreeHalves = _mm_set1_ps(1.5f);
+
+		const __m128 X2 = _mm_mul_ps(V, Half);
+		__m128 Y = _mm_castsi128_ps(_mm_sub_epi32(_mm_set1_epi32(0x5F3759DF), _mm_srli_epi32(_mm_castps_si128(V), 1)));
+		Y = _mm_mul_ps(Y, _mm_sub_ps(ThreeHalves, _mm_mul_ps(_mm_mul_ps(X2, Y), Y)));
+		Y = _mm_mul_ps(Y, _mm_sub_ps(ThreeHalves, _mm_mul_ps(_mm_mul_ps(X2, Y), Y)));
+		Y = _mm_mul_ps(Y, _mm_sub_ps(ThreeHalves, _mm_mul_ps(_mm_mul_ps(X2, Y), Y)));
+		return Y;
+	}
+	// float area of the triangles whose corners are in X0 ~ Z2, one per lane
+	static __m128 TriangleArea32SSE2(__m128 X0, __m128 Y0, __m128 Z0, __m128 X1, __m128 Y1, __m128 Z1, __m128 X2, __m128 Y2, __m128 Z2)
+	{
+		const __m128 d0X = _mm_sub_ps(X1, X0);
+		const __m128 d0Y = _mm_sub_ps(Y1, Y0);
+		const __m128 d0Z = _mm_sub_ps(Z1, Z0);
+
+		const __m128 d1X = _mm_sub_ps(X2, X0);
+		const __m128 d1Y = _mm_sub_ps(Y2, Y0);
+		const __m128 d1Z = _mm_sub_ps(Z2, Z0);
+
+		const __m128 cX = _mm_sub_ps(_mm_mul_ps(d0Y, d1Z), _mm_mul_ps(d0Z, d1Y));
+		const __m128 cY = _mm_sub_ps(_mm_mul_ps(d0Z, d1X), _mm_mul_ps(d0X, d1Z));
+		const __m128 cZ = _mm_sub_ps(_mm_mul_ps(d0X, d1Y), _mm_mul_ps(d0Y, d1X));
+
+		const __m128 Magnitude = _mm_add_ps(_mm_add_ps(_mm_mul_ps(cX, cX), _mm_mul_ps(cY, cY)), _mm_mul_ps(cZ, cZ));
+		return _mm_mul_ps(_mm_div_ps(_mm_set1_ps(1.f), Rsqrt32SSE2(Magnitude)), _mm_set1_ps(0.5f));
+	}
+
+	static bool CoordsFitFloatSSE2(const double* Src, unsigned long long Count)
+	{
+		const __m128d AbsMask = _mm_castsi128_pd(_mm_set1_epi64x(0x7FFFFFFFFFFFFFFF));
+		const __m128d Lower = _mm_set1_pd(FLT_MIN);
+		const __m128d Upper = _mm_set1_pd(8796093022208.0);
+		const __m128d Epsilon = _mm_set1_pd(FLT_EPSILON);
+
+		const double* i = Src;
+		for (const double* e = Src + (Count & ~1ull); i != e; i += 2)
+		{
+			const __m128d CurValue64 = _mm_and_pd(_mm_loadu_pd(i), AbsMask);
+			const __m128d CurValue32 = _mm_cvtps_pd(_mm_cvtpd_ps(CurValue64));
+			const __m128d Diff = _mm_and_pd(_mm_sub_pd(CurValue64, CurValue32), AbsMask);
+
+			const __m128d Fail = _mm_or_pd(_mm_or_pd(_mm_cmple_pd(CurValue64, Lower), _mm_cmpge_pd(CurValue64, Upper)), _mm_cmple_pd(Diff, Epsilon));
+			if (_mm_movemask_pd(Fail) != 0)
+			{
+				return false;
+			}
+		}
+		return CoordsFitFloat(i, Count - (i - Src));
+	}
+	static bool TrianglesFitFloatSSE2(const double* Verts, const unsigned long* Inds, unsigned long long TriCount)
+	{
+		const __m128d AbsMask = _mm_castsi128_pd(_mm_set1_epi64x(0x7FFFFFFFFFFFFFFF));
+		const __m128d Lower = _mm_set1_pd(FLT_MIN);
+		const __m128d Upper = _mm_set1_pd(8796093022208.0);
+		const __m128d Epsilon = _mm_set1_pd(FLT_EPSILON);
+
+		const unsigned long* i = Inds;
+		for (const unsigned long* e = Inds + ((TriCount & ~1ull) * 3u); i != e; i += 6)
+		{
+			const double* A0 = Verts + (i[0] * 3u);
+			const double* A1 = Verts + (i[1] * 3u);
+			const double* A2 = Verts + (i[2] * 3u);
+			const double* B0 = Verts + (i[3] * 3u);
+			const double* B1 = Verts + (i[4] * 3u);
+			const double* B2 = Verts + (i[5] * 3u);
+
+			const __m128d X0 = _mm_set_pd(B0[0], A0[0]), Y0 = _mm_set_pd(B0[1], A0[1]), Z0 = _mm_set_pd(B0[2], A0[2]);
+			const __m128d X1 = _mm_set_pd(B1[0], A1[0]), Y1 = _mm_set_pd(B1[1], A1[1]), Z1 = _mm_set_pd(B1[2], A1[2]);
+			const __m128d X2 = _mm_set_pd(B2[0], A2[0]), Y2 = _mm_set_pd(B2[1], A2[1]), Z2 = _mm_set_pd(B2[2], A2[2]);
+
+			__m128d Magnitude64;
+			{
+				const __m128d d0X = _mm_sub_pd(X1, X0);
+				const __m128d d0Y = _mm_sub_pd(Y1, Y0);
+				const __m128d d0Z = _mm_sub_pd(Z1, Z0);
+
+				const __m128d d1X = _mm_sub_pd(X2, X0);
+				const __m128d d1Y = _mm_sub_pd(Y2, Y0);
+				const __m128d d1Z = _mm_sub_pd(Z2, Z0);
+
+				const __m128d cX = _mm_sub_pd(_mm_mul_pd(d0Y, d1Z), _mm_mul_pd(d0Z, d1Y));
+				const __m128d cY = _mm_sub_pd(_mm_mul_pd(d0Z, d1X), _mm_mul_pd(d0X, d1Z));
+				const __m128d cZ = _mm_sub_pd(_mm_mul_pd(d0X, d1Y), _mm_mul_pd(d0Y, d1X));
+
+				const __m128d Magnitude = _mm_add_pd(_mm_add_pd(_mm_mul_pd(cX, cX), _mm_mul_pd(cY, cY)), _mm_mul_pd(cZ, cZ));
+				Magnitude64 = _mm_mul_pd(_mm_div_pd(_mm_set1_pd(1.), Rsqrt64SSE2(Magnitude)), _mm_set1_pd(0.5));
+			}
+
+			// the upper two float lanes are unused
+			const __m128 Magnitude32 = TriangleArea32SSE2(
+				_mm_cvtpd_ps(X0), _mm_cvtpd_ps(Y0), _mm_cvtpd_ps(Z0),
+				_mm_cvtpd_ps(X1), _mm_cvtpd_ps(Y1), _mm_cvtpd_ps(Z1),
+				_mm_cvtpd_ps(X2), _mm_cvtpd_ps(Y2), _mm_cvtpd_ps(Z2)
+				);
+
+			const __m128d Diff = _mm_and_pd(_mm_sub_pd(Magnitude64, _mm_cvtps_pd(Magnitude32)), AbsMask);
+
+			const __m128d Fail = _mm_or_pd(_mm_or_pd(_mm_cmple_pd(Magnitude64, Lower), _mm_cmpge_pd(Magnitude64, Upper)), _mm_cmple_pd(Diff, Epsilon));
+			if (_mm_movemask_pd(Fail) != 0)
+			{
+				return false;
+			}
+		}
+		return TrianglesFitFloat(Verts, i, TriCount - ((i - Inds) / 3u));
+	}
+#endif
+
+#ifdef USE_AVX2
+	TARGET_AVX2 static __m256d Rsqrt64AVX2(__m256d V)
+	{
+		const __m256d Half = _mm256_set1_pd(0.5);
+		const __m256d ThreeHalves = _mm256_set1_pd(1.5);
+
+		const __m256d X2 = _mm256_mul_pd(V, Half);
+		__m256d Y = _mm256_castsi256_pd(_mm256_sub_epi64(_mm256_set1_epi64x(0x5fe6eb50c7b537a9), _mm256_srli_epi64(_mm256_castpd_si256(V), 1)));
+		Y = _mm256_mul_pd(Y, _mm256_sub_pd(ThreeHalves, _mm256_mul_pd(_mm256_mul_pd(X2, Y), Y)));
+		Y = _mm256_mul_pd(Y, _mm256_sub_pd(ThreeHalves, _mm256_mul_pd(_mm256_mul_pd(X2, Y), Y)));
+		Y = _mm256_mul_pd(Y, _mm256_sub_pd(ThreeHalves, _mm256_mul_pd(_mm256_mul_pd(X2, Y), Y)));
+		return Y;
+	}
+
+	TARGET_AVX2 static bool CoordsFitFloatAVX2(const double* Src, unsigned long long Count)
+	{
+		const __m256d AbsMask = _mm256_castsi256_pd(_mm256_set1_epi64x(0x7FFFFFFFFFFFFFFF));
+		const __m256d Lower = _mm256_set1_pd(FLT_MIN);
+		const __m256d Upper = _mm256_set1_pd(8796093022208.0);
+		const __m256d Epsilon = _mm256_set1_pd(FLT_EPSILON);
+
+		const double* i = Src;
+		for (const double* e = Src + (Count & ~3ull); i != e; i += 4)
+		{
+			const __m256d CurValue64 = _mm256_and_pd(_mm256_loadu_pd(i), AbsMask);
+			const __m256d CurValue32 = _mm256_cvtps_pd(_mm256_cvtpd_ps(CurValue64));
+			const __m256d Diff = _mm256_and_pd(_mm256_sub_pd(CurValue64, CurValue32), AbsMask);
+
+			const __m256d Fail = _mm256_or_pd(_mm256_or_pd(_mm256_cmp_pd(CurValue64, Lower, _CMP_LE_OQ), _mm256_cmp_pd(CurValue64, Upper, _CMP_GE_OQ)), _mm256_cmp_pd(Diff, Epsilon, _CMP_LE_OQ));
+			if (_mm256_movemask_pd(Fail) != 0)
+			{
+				return false;
+			}
+		}
+		return CoordsFitFloat(i, Count - (i - Src));
+	}
+	TARGET_AVX2 static bool TrianglesFitFloatAVX2(const double* Verts, const unsigned long* Inds, unsigned long long TriCount)
+	{
+		const __m256d AbsMask = _mm256_castsi256_pd(_mm256_set1_epi64x(0x7FFFFFFFFFFFFFFF));
+		const __m256d Lower = _mm256_set1_pd(FLT_MIN);
+		const __m256d Upper = _mm256_set1_pd(8796093022208.0);
+		const __m256d Epsilon = _mm256_set1_pd(FLT_EPSILON);
+
+		const unsigned long* i = Inds;
+		for (const unsigned long* e = Inds + ((TriCount & ~3ull) * 3u); i != e; i += 12)
+		{
+			const double* A0 = Verts + (i[0] * 3u);
+			const double* A1 = Verts + (i[1] * 3u);
+			const double* A2 = Verts + (i[2] * 3u);
+			const double* B0 = Verts + (i[3] * 3u);
+			const double* B1 = Verts + (i[4] * 3u);
+			const double* B2 = Verts + (i[5] * 3u);
+			const double* C0 = Verts + (i[6] * 3u);
+			const double* C1 = Verts + (i[7] * 3u);
+			const double* C2 = Verts + (i[8] * 3u);
+			const double* D0 = Verts + (i[9] * 3u);
+			const double* D1 = Verts + (i[10] * 3u);
+			const double* D2 = Verts + (i[11] * 3u);
+
+			const __m256d X0 = _mm256_set_pd(D0[0], C0[0], B0[0], A0[0]), Y0 = _mm256_set_pd(D0[1], C0[1], B0[1], A0[1]), Z0 = _mm256_set_pd(D0[2], C0[2], B0[2], A0[2]);
+			const __m256d X1 = _mm256_set_pd(D1[0], C1[0], B1[0], A1[0]), Y1 = _mm256_set_pd(D1[1], C1[1], B1[1], A1[1]), Z1 = _mm256_set_pd(D1[2], C1[2], B1[2], A1[2]);
+			const __m256d X2 = _mm256_set_pd(D2[0], C2[0], B2[0], A2[0]), Y2 = _mm256_set_pd(D2[1], C2[1], B2[1], A2[1]), Z2 = _mm256_set_pd(D2[2], C2[2], B2[2], A2[2]);
+
+			__m256d Magnitude64;
+			{
+				const __m256d d0X = _mm256_sub_pd(X1, X0);
+				const __m256d d0Y = _mm256_sub_pd(Y1, Y0);
+				const __m256d d0Z = _mm256_sub_pd(Z1, Z0);
+
+				const __m256d d1X = _mm256_sub_pd(X2, X0);
+				const __m256d d1Y = _mm256_sub_pd(Y2, Y0);
+				const __m256d d1Z = _mm256_sub_pd(Z2, Z0);
+
+				const __m256d cX = _mm256_sub_pd(_mm256_mul_pd(d0Y, d1Z), _mm256_mul_pd(d0Z, d1Y));
+				const __m256d cY = _mm256_sub_pd(_mm256_mul_pd(d0Z, d1X), _mm256_mul_pd(d0X, d1Z));
+				const __m256d cZ = _mm256_sub_pd(_mm256_mul_pd(d0X, d1Y), _mm256_mul_pd(d0Y, d1X));
+
+				const __m256d Magnitude = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(cX, cX), _mm256_mul_pd(cY, cY)), _mm256_mul_pd(cZ, cZ));
+				Magnitude64 = _mm256_mul_pd(_mm256_div_pd(_mm256_set1_pd(1.), Rsqrt64AVX2(Magnitude)), _mm256_set1_pd(0.5));
+			}
+
+			const __m128 Magnitude32 = TriangleArea32SSE2(
+				_mm256_cvtpd_ps(X0), _mm256_cvtpd_ps(Y0), _mm256_cvtpd_ps(Z0),
+				_mm256_cvtpd_ps(X1), _mm256_cvtpd_ps(Y1), _mm256_cvtpd_ps(Z1),
+				_mm256_cvtpd_ps(X2), _mm256_cvtpd_ps(Y2), _mm256_cvtpd_ps(Z2)
+				);
+
+			const __m256d Diff = _mm256_and_pd(_mm256_sub_pd(Magnitude64, _mm256_cvtps_pd(Magnitude32)), AbsMask);
+
+			const __m256d Fail = _mm256_or_pd(_mm256_or_pd(_mm256_cmp_pd(Magnitude64, Lower, _CMP_LE_OQ), _mm256_cmp_pd(Magnitude64, Upper, _CMP_GE_OQ)), _mm256_cmp_pd(Diff, Epsilon, _CMP_LE_OQ));
+			if (_mm256_movemask_pd(Fail) != 0)
+			{
+				return false;
+			}
+		}
+		return TrianglesFitFloatSSE2(Verts, i, TriCount - ((i - Inds) / 3u));
+	}
+#endif
+
+
+	// one vertex into world space and into the bounds
+	static void TransformMinMax(const double* Scale, const double* Rotation, const double* Position, const double* Src, double* Min, double* Max)
+	{
+		double X = Src[0] * Scale[0];
+		double Y = Src[1] * Scale[1];
+		double Z = Src[2] * Scale[2];
+
+		{ // http://people.csail.mit.edu/bkph/articles/Quaternions.pdf
+			double TTX = 2. * (Rotation[1] * Z - Rotation[2] * Y);
+			double TTY = 2. * (Rotation[2] * X - Rotation[0] * Z);
+			double TTZ = 2. * (Rotation[0] * Y - Rotation[1] * X);
+
+			const double TT2X = 2. * (Rotation[1] * TTZ - Rotation[2] * TTY);
+			const double TT2Y = 2. * (Rotation[2] * TTX - Rotation[0] * TTZ);
+			const double TT2Z = 2. * (Rotation[0] * TTY - Rotation[1] * TTX);
+
+			TTX *= Rotation[3];
+			TTY *= Rotation[3];
+			TTZ *= Rotation[3];
+
+			X += TTX + TT2X;
+			Y += TTY + TT2Y;
+			Z += TTZ + TT2Z;
+		}
+
+		X += Position[0];
+		Y += Position[1];
+		Z += Position[2];
+
+		Min[0] = (Min[0] > X) ? X : Min[0];
+		Min[1] = (Min[1] > Y) ? Y : Min[1];
+		Min[2] = (Min[2] > Z) ? Z : Min[2];
+
+		Max[0] = (Max[0] < X) ? X : Max[0];
+		Max[1] = (Max[1] < Y) ? Y : Max[1];
+		Max[2] = (Max[2] < Z) ? Z : Max[2];
+	}
+	// Count consecutive vertices
+	static void TransformMinMaxRun(const double* Scale, const double* Rotation, const double* Position, const double* Src, unsigned long long Count, double* Min, double* Max)
+	{
+		for (const double* SrcEnd = Src + (Count * 3u); Src != SrcEnd; Src += 3u)
+		{
+			TransformMinMax(Scale, Rotation, Position, Src, Min, Max);
+		}
+	}
+
+#ifdef USE_SSE2
+	// two vertices per step
+	static void TransformMinMaxRunSSE2(const double* Scale, const double* Rotation, const double* Position, const double* Src, unsigned long long Count, double* Min, double* Max)
+	{
+		const __m128d Two = _mm_set1_pd(2.);
+		const __m128d S0 = _mm_set1_pd(Scale[0]), S1 = _mm_set1_pd(Scale[1]), S2 = _mm_set1_pd(Scale[2]);
+		const __m128d R0 = _mm_set1_pd(Rotation[0]), R1 = _mm_set1_pd(Rotation[1]), R2 = _mm_set1_pd(Rotation[2]), R3 = _mm_set1_pd(Rotation[3]);
+		const __m128d P0 = _mm_set1_pd(Position[0]), P1 = _mm_set1_pd(Position[1]), P2 = _mm_set1_pd(Position[2]);
+
+		__m128d MinX = _mm_set1_pd(Min[0]), MinY = _mm_set1_pd(Min[1]), MinZ = _mm_set1_pd(Min[2]);
+		__m128d MaxX = _mm_set1_pd(Max[0]), MaxY = _mm_set1_pd(Max[1]), MaxZ = _mm_set1_pd(Max[2]);
+
+		const double* SrcEnd = Src + ((Count & ~1ull) * 3u);
+		for (; Src != SrcEnd; Src += 6u)
+		{
+			// [x0 y0] [z0 x1] [y1 z1]
+			const __m128d A = _mm_loadu_pd(Src);
+			const __m128d B = _mm_loadu_pd(Src + 2u);
+			const __m128d C = _mm_loadu_pd(Src + 4u);
+
+			__m128d X = _mm_mul_pd(_mm_shuffle_pd(A, B, 0x2), S0);
+			__m128d Y = _mm_mul_pd(_mm_shuffle_pd(A, C, 0x1), S1);
+			__m128d Z = _mm_mul_pd(_mm_shuffle_pd(B, C, 0x2), S2);
+
+			{
+				__m128d TTX = _mm_mul_pd(Two, _mm_sub_pd(_mm_mul_pd(R1, Z), _mm_mul_pd(R2, Y)));
+				__m128d TTY = _mm_mul_pd(Two, _mm_sub_pd(_mm_mul_pd(R2, X), _mm_mul_pd(R0, Z)));
+				__m128d TTZ = _mm_mul_pd(Two, _mm_sub_pd(_mm_mul_pd(R0, Y), _mm_mul_pd(R1, X)));
+
+				const __m128d TT2X = _mm_mul_pd(Two, _mm_sub_pd(_mm_mul_pd(R1, TTZ), _mm_mul_pd(R2, TTY)));
+				const __m128d TT2Y = _mm_mul_pd(Two, _mm_sub_pd(_mm_mul_pd(R2, TTX), _mm_mul_pd(R0, TTZ)));
+				const __m128d TT2Z = _mm_mul_pd(Two, _mm_sub_pd(_mm_mul_pd(R0, TTY), _mm_mul_pd(R1, TTX)));
+
+				TTX = _mm_mul_pd(TTX, R3);
+				TTY = _mm_mul_pd(TTY, R3);
+				TTZ = _mm_mul_pd(TTZ, R3);
+
+				X = _mm_add_pd(X, _mm_add_pd(TTX, TT2X));
+				Y = _mm_add_pd(Y, _mm_add_pd(TTY, TT2Y));
+				Z = _mm_add_pd(Z, _mm_add_pd(TTZ, TT2Z));
+			}
+
+			X = _mm_add_pd(X, P0);
+			Y = _mm_add_pd(Y, P1);
+			Z = _mm_add_pd(Z, P2);
+
+			// the new value goes first, so a nan keeps the bound like the scalar compare does
+			MinX = _mm_min_pd(X, MinX);
+			MinY = _mm_min_pd(Y, MinY);
+			MinZ = _mm_min_pd(Z, MinZ);
+
+			MaxX = _mm_max_pd(X, MaxX);
+			MaxY = _mm_max_pd(Y, MaxY);
+			MaxZ = _mm_max_pd(Z, MaxZ);
+		}
+
+		{
+			double Lanes[2];
+
+			_mm_storeu_pd(Lanes, _mm_min_pd(MinX, _mm_unpackhi_pd(MinX, MinX)));
+			Min[0] = Lanes[0];
+			_mm_storeu_pd(Lanes, _mm_min_pd(MinY, _mm_unpackhi_pd(MinY, MinY)));
+			Min[1] = Lanes[0];
+			_mm_storeu_pd(Lanes, _mm_min_pd(MinZ, _mm_unpackhi_pd(MinZ, MinZ)));
+			Min[2] = Lanes[0];
+
+			_mm_storeu_pd(Lanes, _mm_max_pd(MaxX, _mm_unpackhi_pd(MaxX, MaxX)));
+			Max[0] = Lanes[0];
+			_mm_storeu_pd(Lanes, _mm_max_pd(MaxY, _mm_unpackhi_pd(MaxY, MaxY)));
+			Max[1] = Lanes[0];
+			_mm_storeu_pd(Lanes, _mm_max_pd(MaxZ, _mm_unpackhi_pd(MaxZ, MaxZ)));
+			Max[2] = Lanes[0];
+		}
+
+		TransformMinMaxRun(Scale, Rotation, Position, Src, Count & 1u, Min, Max);
+	}
+#endif
+
+#ifdef USE_AVX2
+	// four vertices per step
+	TARGET_AVX2 static void TransformMinMaxRunAVX2(const double* Scale, const double* Rotation, const double* Position, const double* Src, unsigned long long Count, double* Min, double* Max)
+	{
+		const __m256d Two = _mm256_set1_pd(2.);
+		const __m256d S0 = _mm256_set1_pd(Scale[0]), S1 = _mm256_set1_pd(Scale[1]), S2 = _mm256_set1_pd(Scale[2]);
+		const __m256d R0 = _mm256_set1_pd(Rotation[0]), R1 = _mm256_set1_pd(Rotation[1]), R2 = _mm256_set1_pd(Rotation[2]), R3 = _mm256_set1_pd(Rotation[3]);
+		const __m256d P0 = _mm256_set1_pd(Position[0]), P1 = _mm256_set1_pd(Position[1]), P2 = _mm256_set1_pd(Position[2]);
+
+		__m256d MinX = _mm256_set1_pd(Min[0]), MinY = _mm256_set1_pd(Min[1]), MinZ = _mm256_set1_pd(Min[2]);
+		__m256d MaxX = _mm256_set1_pd(Max[0]), MaxY = _mm256_set1_pd(Max[1]), MaxZ = _mm256_set1_pd(Max[2]);
+
+		const double* SrcEnd = Src + ((Count & ~3ull) * 3u);
+		for (; Src != SrcEnd; Src += 12u)
+		{
+			// [x0 y0 z0 x1] [y1 z1 x2 y2] [z2 x3 y3 z3]
+			const __m256d A = _mm256_loadu_pd(Src);
+			const __m256d B = _mm256_loadu_pd(Src + 4u);
+			const __m256d C = _mm256_loadu_pd(Src + 8u);
+
+			// [x0 y0 x2 y2] [z0 x1 z2 x3] [y1 z1 y3 z3]
+			const __m256d P = _mm256_blend_pd(A, B, 0xC);
+			const __m256d Q = _mm256_permute2f128_pd(A, C, 0x21);
+			const __m256d R = _mm256_permute2f128_pd(B, C, 0x30);
+
+			__m256d X = _mm256_mul_pd(_mm256_shuffle_pd(P, Q, 0xA), S0);
+			__m256d Y = _mm256_mul_pd(_mm256_shuffle_pd(P, R, 0x5), S1);
+			__m256d Z = _mm256_mul_pd(_mm256_shuffle_pd(Q, R, 0xA), S2);
+
+			{
+				__m256d TTX = _mm256_mul_pd(Two, _mm256_sub_pd(_mm256_mul_pd(R1, Z), _mm256_mul_pd(R2, Y)));
+				__m256d TTY = _mm256_mul_pd(Two, _mm256_sub_pd(_mm256_mul_pd(R2, X), _mm256_mul_pd(R0, Z)));
+				__m256d TTZ = _mm256_mul_pd(Two, _mm256_sub_pd(_mm256_mul_pd(R0, Y), _mm256_mul_pd(R1, X)));
+
+				const __m256d TT2X = _mm256_mul_pd(Two, _mm256_sub_pd(_mm256_mul_pd(R1, TTZ), _mm256_mul_pd(R2, TTY)));
+				const __m256d TT2Y = _mm256_mul_pd(Two, _mm256_sub_pd(_mm256_mul_pd(R2, TTX), _mm256_mul_pd(R0, TTZ)));
+				const __m256d TT2Z = _mm256_mul_pd(Two, _mm256_sub_pd(_mm256_mul_pd(R0, TTY), _mm256_mul_pd(R1, TTX)));
+
+				TTX = _mm256_mul_pd(TTX, R3);
+				TTY = _mm256_mul_pd(TTY, R3);
+				TTZ = _mm256_mul_pd(TTZ, R3);
+
+				X = _mm256_add_pd(X, _mm256_add_pd(TTX, TT2X));
+				Y = _mm256_add_pd(Y, _mm256_add_pd(TTY, TT2Y));
+				Z = _mm256_add_pd(Z, _mm256_add_pd(TTZ, TT2Z));
+			}
+
+			X = _mm256_add_pd(X, P0);
+			Y = _mm256_add_pd(Y, P1);
+			Z = _mm256_add_pd(Z, P2);
+
+			MinX = _mm256_min_pd(X, MinX);
+			MinY = _mm256_min_pd(Y, MinY);
+			MinZ = _mm256_min_pd(Z, MinZ);
+
+			MaxX = _mm256_max_pd(X, MaxX);
+			MaxY = _mm256_max_pd(Y, MaxY);
+			MaxZ = _mm256_max_pd(Z, MaxZ);
+		}
+
+		{
+			double Lanes[4];
+
+			_mm256_storeu_pd(Lanes, _mm256_min_pd(MinX, _mm256_permute2f128_pd(MinX, MinX, 0x1)));
+			Min[0] = (Lanes[0] < Lanes[1]) ? Lanes[0] : Lanes[1];
+			_mm256_storeu_pd(Lanes, _mm256_min_pd(MinY, _mm256_permute2f128_pd(MinY, MinY, 0x1)));
+			Min[1] = (Lanes[0] < Lanes[1]) ? Lanes[0] : Lanes[1];
+			_mm256_storeu_pd(Lanes, _mm256_min_pd(MinZ, _mm256_permute2f128_pd(MinZ, MinZ, 0x1)));
+			Min[2] = (Lanes[0] < Lanes[1]) ? Lanes[0] : Lanes[1];
+
+			_mm256_storeu_pd(Lanes, _mm256_max_pd(MaxX, _mm256_permute2f128_pd(MaxX, MaxX, 0x1)));
+			Max[0] = (Lanes[0] > Lanes[1]) ? Lanes[0] : Lanes[1];
+			_mm256_storeu_pd(Lanes, _mm256_max_pd(MaxY, _mm256_permute2f128_pd(MaxY, MaxY, 0x1)));
+			Max[1] = (Lanes[0] > Lanes[1]) ? Lanes[0] : Lanes[1];
+			_mm256_storeu_pd(Lanes, _mm256_max_pd(MaxZ, _mm256_permute2f128_pd(MaxZ, MaxZ, 0x1)));
+			Max[2] = (Lanes[0] > Lanes[1]) ? Lanes[0] : Lanes[1];
+		}
+
+		TransformMinMaxRun(Scale, Rotation, Position, Src, Count & 3u, Min, Max);
+	}
+#endif
+
+	// bytes of scratch ComputeMinMax uses for VertCount coordinates
+	static unsigned long long MinMaxScratchSize(unsigned long VertCount)
+	{
+		return ((static_cast<unsigned long long>(VertCount / 3u) + 63u) >> 6u) << 3u;
+	}
+	// world space bounds of the indexed vertices. Scratch holds a bit per vertex, so shared vertices are transformed once
+	static void ComputeMinMax(
+		const double* Scale,
+		const double* Rotation,
+		const double* Position,
+		unsigned long VertCount,
+		unsigned long IndCount,
+		const double* Verts,
+		const unsigned long* Inds,
+		TempBuffer<unsigned char>* Scratch,
+		MinMax* Out
+		)
+	{
+		const unsigned long PointCount = VertCount / 3u;
+		const unsigned long long WordCount = MinMaxScratchSize(VertCount) >> 3u;
+
+		Scratch->Resize(WordCount << 3u);
+
+		unsigned long long* Referenced = reinterpret_cast<unsigned long long*>(Scratch->Get());
+		{
+			Memset(Referenced, 0ull, WordCount << 3u);
+
+			// indices out of range are left to the encoder to reject, as this may run alongside it
+			for (const unsigned long *Src = Inds, *SrcEnd = Inds + IndCount; Src != SrcEnd; ++Src)
+			{
+				if ((*Src) < PointCount)
+				{
+					Referenced[(*Src) >> 6u] |= 1ull << ((*Src) & 63u);
+				}
+			}
+		}
+
+		auto Run = TransformMinMaxRun;
+#ifdef USE_AVX2
+		if (HasAVX2())
+		{
+			Run = TransformMinMaxRunAVX2;
+		}
+		else
+#endif
+		{
+#ifdef USE_SSE2
+			Run = TransformMinMaxRunSSE2;
+#endif
+		}
+
+		double GeometryMin[] = { DBL_MAX, DBL_MAX, DBL_MAX };
+		double GeometryMax[] = { -DBL_MAX, -DBL_MAX, -DBL_MAX };
+		for (unsigned long long Word = 0u; Word < WordCount;)
+		{
+			// fully referenced words are merged into one run, the rest go vertex by vertex
+			if (Referenced[Word] == ~0ull)
+			{
+				unsigned long long WordEnd = Word + 1u;
+				for (; (WordEnd < WordCount) && (Referenced[WordEnd] == ~0ull); ++WordEnd);
+
+				Run(Scale, Rotation, Position, Verts + ((Word << 6u) * 3u), (WordEnd - Word) << 6u, GeometryMin, GeometryMax);
+				Word = WordEnd;
+				continue;
+			}
+
+			unsigned long long Bits = Referenced[Word];
+			for (const double* Src = Verts + ((Word << 6u) * 3u); Bits != 0u; Bits >>= 1u, Src += 3u)
+			{
+				if ((Bits & 1u) != 0u)
+				{
+					TransformMinMax(Scale, Rotation, Position, Src, GeometryMin, GeometryMax);
+				}
+			}
+			++Word;
 		}
 
-#ifdef USE_LZMA2
-		static const unsigned long PropSize = 1u;
-#else
-		static const unsigned long PropSize = LZMA_PROPS_SIZE;
-#endif
+		Memcpy(Out->Min, GeometryMin, sizeof(GeometryMin));
+		Memcpy(Out->Max, GeometryMax, sizeof(GeometryMax));
+	}
+};
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+bool __common_memset(void* Dest, int V, size_t Len)
+{
+	return __hidden_GeometryIOProcessor::Memset(reinterpret_cast<unsigned char*>(Dest), static_cast<unsigned char>(V), Len);
+}
+bool __common_memmove(void* Dest, const void* Src, size_t Len)
+{
+	return __hidden_GeometryIOProcessor::Memmove(Dest, Src, Len);
+}
+bool __common_memcpy(void* _restrict Dest, const void* _restrict Src, size_t Len)
+{
+	return __hidden_GeometryIOProcessor::Memcpy(Dest, Src, Len);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+bool GeometryWriter::Encode(
+	const double* Scale,
+	const double* Rotation,
+	const double* Position,
+	unsigned long VertCount,
+	unsigned long IndCount,
+	const double* Verts,
+	const unsigned long* Inds,
+	unsigned long long* EncodedSize,
+	unsigned char** EncodedData,
+
+	unsigned long OptionalEncodeOffset,
+	bool OptionalUseFloat32Vertex,
+	unsigned long* OptionalVertexRemap
+	)
+{
+	const unsigned long RemapCount = OptionalVertexRemap ? (VertCount / 3u) : 0u;
+	for (unsigned long i = 0u; i < RemapCount; ++i)
+	{
+		OptionalVertexRemap[i] = i;
+	}
+
+	if (Options.WeldVertices && WeldVertices(VertCount, IndCount, Verts, Inds, OptionalVertexRemap, RemapCount))
+	{
+		VertCount = static_cast<unsigned long>(TempVertsForWeld.Size());
+		Verts = TempVertsForWeld.Get();
+		Inds = TempIndsForWeld.Get();
+	}
+	if (Options.ReorderForVertexCache && ReorderForVertexCache(VertCount, IndCount, Verts, Inds, OptionalVertexRemap, RemapCount))
+	{
+		Verts = TempVertsForReorder.Get();
+		Inds = TempIndsForReorder.Get();
+	}
 
-		const SizeT srcLen = TempSrcForEncoding.Size();
-		SizeT destLen = srcLen;
-		{
-			destLen += destLen / 3 + 128u;
-			
-			TempDestForEncoding.Resize(8u + PropSize + destLen);
-		}
+	if (!Pack(Scale, Rotation, Position, VertCount, IndCount, Verts, Inds, OptionalUseFloat32Vertex))
+	{
+		return false;
+	}
 
-#ifdef USE_LZMA2
-		CLzma2EncProps props;
-		Lzma2EncProps_Init(&props);
-		props.lzmaProps.level = 5;
-		props.lzmaProps.lc = 3;
-		props.lzmaProps.lp = 0;
-		props.lzmaProps.pb = 2;
-		props.lzmaProps.fb = 32;
-		props.lzmaProps.numThreads = 8;
-		
-		SRes res = __hidden_GeometryIOProcessor::LZMA2Encode(TempDestForEncoding.Get() + 8u + PropSize, &destLen, TempDestForEncoding.Get() + 8u, TempSrcForEncoding.Get(), srcLen, &props, nullptr, &allocator, &allocator);
-#else
-		CLzmaEncProps props;
-		LzmaEncProps_Init(&props);
-		props.level = 5;
-		props.lc = 3;
-		props.lp = 0;
-		props.pb = 2;
-		props.fb = 32;
-		props.numThreads = 2;
-
-		SizeT propsSize = PropSize;
-		
-		SRes res = LzmaEncode(TempDestForEncoding.Get() + 8u + PropSize, &destLen, TempSrcForEncoding.Get(), srcLen, &props, TempDestForEncoding.Get() + 8u, &propsSize, 0, nullptr, &allocator, &allocator);
-#endif
-		if (res != SZ_OK)
+	{
+		const unsigned char Codec = static_cast<unsigned char>(Options.Codec);
+		// lzma payloads keep the original layout, any other codec is named by a byte after the size
+		const unsigned long long TagSize = (Codec != EncodeOptions::CODEC_LZMA) ? 1u : 0u;
+
+		const unsigned long long srcLen = TempSrcForEncoding.Size();
+		unsigned long long destLen = CompressBound(Codec, srcLen);
+		TempDestForEncoding.Resize(8u + TagSize + destLen);
+
+		if (!Compress(Codec, TempSrcForEncoding.Get(), srcLen, TempDestForEncoding.Get() + 8u + TagSize, &destLen))
 		{
-			__hidden_GeometryIOProcessor::LZMAGetErrorMsg(res, &ErrorMsg);
 			return false;
 		}
 
@@ -449,10 +2244,15 @@ bool GeometryWriter::Encode(
 			}
 			else
 			{
-				const unsigned long long BufferSize = srcLen & 0x7FFFFFFFFFFFFFFF;
+				unsigned long long BufferSize = srcLen & 0x3FFFFFFFFFFFFFFF;
+				if (TagSize > 0u)
+				{
+					BufferSize |= 0x4000000000000000;
+					TempDestForEncoding.Get()[8] = Codec;
+				}
 			
 				__hidden_GeometryIOProcessor::Memcpy(TempDestForEncoding.Get(), &BufferSize, 8u);
-				TempDestForEncoding.Resize(8u + PropSize + destLen);
+				TempDestForEncoding.Resize(8u + TagSize + destLen);
 			}
 		}
 	}
@@ -465,6 +2265,201 @@ bool GeometryWriter::Encode(
 	return true;
 }
 
+void GeometryWriter::SetEncodeOptions(const EncodeOptions& NewOptions)
+{
+	Options = NewOptions;
+}
+
+GeometryWriter::EncodeOptions GeometryWriter::EncodeOptions::Fastest()
+{
+	EncodeOptions Result;
+	Result.Level = 1;
+	Result.MatchFinder = MATCHFINDER_HC5;
+	Result.ThreadCount = 0u;
+	return Result;
+}
+GeometryWriter::EncodeOptions GeometryWriter::EncodeOptions::Balanced()
+{
+	EncodeOptions Result;
+	// the lzma settings of older writers, coded as one solid block like they were. the dictionary is still sized from each payload, so the output is not byte-identical to theirs
+	Result.BlockSize = static_cast<unsigned long long>(-1);
+	return Result;
+}
+GeometryWriter::EncodeOptions GeometryWriter::EncodeOptions::Smallest()
+{
+	EncodeOptions Result;
+	Result.Level = 9;
+	Result.FastBytes = 128;
+	// a single lzma2 block keeps matches reachable across the whole payload
+	Result.BlockSize = static_cast<unsigned long long>(-1);
+	return Result;
+}
+GeometryWriter::EncodeOptions GeometryWriter::EncodeOptions::FastLoad()
+{
+	EncodeOptions Result;
+	Result.Codec = CODEC_LZ;
+	return Result;
+}
+
+unsigned long long GeometryWriter::CompressBound(unsigned char Codec, unsigned long long SrcLen)
+{
+	switch (Codec)
+	{
+	case EncodeOptions::CODEC_LZ:
+		return __hidden_GeometryIOProcessor::LZCompressBound(SrcLen);
+
+	default:
+		{
+#ifdef USE_LZMA2
+			static const unsigned long PropSize = 1u;
+#else
+			static const unsigned long PropSize = LZMA_PROPS_SIZE;
+#endif
+
+			return PropSize + SrcLen + (SrcLen / 3u + 128u);
+		}
+	}
+}
+bool GeometryWriter::Compress(unsigned char Codec, const unsigned char* Src, unsigned long long SrcLen, unsigned char* Dest, unsigned long long* DestLen)
+{
+	switch (Codec)
+	{
+	case EncodeOptions::CODEC_LZ:
+		return CompressLZ(Src, SrcLen, Dest, DestLen);
+
+	default:
+		{
+#ifdef USE_LZMA2
+			static const unsigned long PropSize = 1u;
+#else
+			static const unsigned long PropSize = LZMA_PROPS_SIZE;
+#endif
+
+			unsigned long long DataLen = (*DestLen) - PropSize;
+			if (!CompressLZMA(Src, SrcLen, Dest, Dest + PropSize, &DataLen))
+			{
+				return false;
+			}
+
+			(*DestLen) = PropSize + DataLen;
+			return true;
+		}
+	}
+}
+bool GeometryWriter::CompressLZ(const unsigned char* Src, unsigned long long SrcLen, unsigned char* Dest, unsigned long long* DestLen)
+{
+	if ((*DestLen) < __hidden_GeometryIOProcessor::LZCompressBound(SrcLen))
+	{
+		__hidden_GeometryIOProcessor::SetErrorMsg(__hidden_GeometryIOProcessor::ERRPrefixLZ, "destination buffer too small", &ErrorMsg);
+		return false;
+	}
+
+	const unsigned long TableBits = __hidden_GeometryIOProcessor::LZTableBits(SrcLen);
+	TempTableForEncoding.Resize(1ull << TableBits);
+	__hidden_GeometryIOProcessor::Memset(TempTableForEncoding.Get(), static_cast<unsigned long>(0u), TempTableForEncoding.Size() * sizeof(unsigned long));
+
+	(*DestLen) = __hidden_GeometryIOProcessor::LZCompress(Src, SrcLen, Dest, TempTableForEncoding.Get(), TableBits);
+	return true;
+}
+bool GeometryWriter::CompressLZMA(const unsigned char* Src, unsigned long long SrcLen, unsigned char* Prop, unsigned char* Dest, unsigned long long* DestLen)
+{
+	SizeT destLen = static_cast<SizeT>(*DestLen);
+
+#ifdef USE_LZMA2
+	// match finder tables, dictionary and encoder threads are kept for the next call rather than rebuilt per payload
+	__hidden_GeometryIOProcessor::LZMA2EncoderState* Encoder = static_cast<__hidden_GeometryIOProcessor::LZMA2EncoderState*>(LZMAEncoder);
+	if (!Encoder)
+	{
+		Encoder = reinterpret_cast<__hidden_GeometryIOProcessor::LZMA2EncoderState*>(CustomAlloc(sizeof(__hidden_GeometryIOProcessor::LZMA2EncoderState)));
+		if (!Encoder)
+		{
+			__hidden_GeometryIOProcessor::LZMAGetErrorMsg(SZ_ERROR_MEM, &ErrorMsg);
+			return false;
+		}
+		{
+			Encoder->allocator.Alloc = __hidden_GeometryIOProcessor::LZMAAlloc;
+			Encoder->allocator.Free = __hidden_GeometryIOProcessor::LZMAFree;
+			Encoder->allocator._this = this;
+		}
+
+		Encoder->handle = Lzma2Enc_Create(&Encoder->allocator, &Encoder->allocator);
+		if (!Encoder->handle)
+		{
+			CustomFree(Encoder);
+			__hidden_GeometryIOProcessor::LZMAGetErrorMsg(SZ_ERROR_MEM, &ErrorMsg);
+			return false;
+		}
+		LZMAEncoder = Encoder;
+	}
+
+	{
+		CLzma2EncProps props;
+		Lzma2EncProps_Init(&props);
+		props.numTotalThreads = static_cast<int>(__hidden_GeometryIOProcessor::SetupLZMAProps(Options, SrcLen, &props.lzmaProps));
+
+		// splitting depends on the payload alone, so the result decodes in parallel whatever this writer's thread count was
+		unsigned long long BlockSize = Options.BlockSize;
+		if (BlockSize == 0u)
+		{
+			BlockSize = std::min(std::max(static_cast<unsigned long long>(props.lzmaProps.dictSize) << 2u, 1ull << 20u), 1ull << 28u);
+		}
+		props.blockSize = (SrcLen > BlockSize) ? BlockSize : LZMA2_ENC_PROPS__BLOCK_SIZE__SOLID;
+
+		SRes res = Lzma2Enc_SetProps(Encoder->handle, &props);
+		if (res != SZ_OK)
+		{
+			__hidden_GeometryIOProcessor::LZMAGetErrorMsg(res, &ErrorMsg);
+			return false;
+		}
+	}
+
+	(*Prop) = Lzma2Enc_WriteProperties(Encoder->handle);
+
+	Lzma2Enc_SetDataSize(Encoder->handle, SrcLen);
+
+	SRes res = Lzma2Enc_Encode2(Encoder->handle, nullptr, Dest, &destLen, nullptr, Src, static_cast<SizeT>(SrcLen), nullptr);
+	if (res != SZ_OK)
+	{
+		// don't carry a half finished state into the next payload
+		ReleaseEncoder();
+	}
+#else
+	__hidden_GeometryIOProcessor::ISzAllocForGeometry allocator;
+	{
+		allocator.Alloc = __hidden_GeometryIOProcessor::LZMAAlloc;
+		allocator.Free = __hidden_GeometryIOProcessor::LZMAFree;
+		allocator._this = this;
+	}
+
+	CLzmaEncProps props;
+	__hidden_GeometryIOProcessor::SetupLZMAProps(Options, SrcLen, &props);
+
+	SizeT propsSize = LZMA_PROPS_SIZE;
+	
+	SRes res = LzmaEncode(Dest, &destLen, Src, static_cast<SizeT>(SrcLen), &props, Prop, &propsSize, 0, nullptr, &allocator, &allocator);
+#endif
+	if (res != SZ_OK)
+	{
+		__hidden_GeometryIOProcessor::LZMAGetErrorMsg(res, &ErrorMsg);
+		return false;
+	}
+
+	(*DestLen) = destLen;
+	return true;
+}
+void GeometryWriter::ReleaseEncoder()
+{
+#ifdef USE_LZMA2
+	__hidden_GeometryIOProcessor::LZMA2EncoderState* Encoder = static_cast<__hidden_GeometryIOProcessor::LZMA2EncoderState*>(LZMAEncoder);
+	if (Encoder)
+	{
+		Lzma2Enc_Destroy(Encoder->handle);
+		CustomFree(Encoder);
+		LZMAEncoder = nullptr;
+	}
+#endif
+}
+
 bool GeometryReader::Decode(
 	unsigned long long EncodedSize,
 	const unsigned char* EncodedData,
@@ -476,14 +2471,140 @@ bool GeometryReader::Decode(
 	double** Verts,
 	unsigned long** Inds
 	)
+{
+	return Decode(EncodedSize, EncodedData, Scale, Rotation, Position, VertCount, IndCount, Verts, Inds, nullptr, nullptr, Options.VertexSpace, false);
+}
+bool GeometryReader::Decode(
+	unsigned long long EncodedSize,
+	const unsigned char* EncodedData,
+	double* Scale,
+	double* Rotation,
+	double* Position,
+	unsigned long* VertCount,
+	unsigned long* IndCount,
+	double** Verts,
+	unsigned long** Inds,
+	DestAlloc Alloc,
+	void* Context
+	)
+{
+	return Decode(EncodedSize, EncodedData, Scale, Rotation, Position, VertCount, IndCount, Verts, Inds, Alloc, Context, Options.VertexSpace, false);
+}
+bool GeometryReader::Decode(
+	unsigned long long EncodedSize,
+	const unsigned char* EncodedData,
+	double* Scale,
+	double* Rotation,
+	double* Position,
+	unsigned long* VertCount,
+	unsigned long* IndCount,
+	double** Verts,
+	unsigned long** Inds,
+	DestAlloc Alloc,
+	void* Context,
+	DecodeOptions::VertexSpaceType Space,
+	bool bFloatVerts
+	)
 {
 	unsigned long long BufferSize = *reinterpret_cast<const unsigned long long*>(EncodedData);
 	const bool bNeedDecode = ((BufferSize & 0x8000000000000000) == 0u);
-	BufferSize &= 0x7FFFFFFFFFFFFFFF;
+	const bool bHasCodec = ((BufferSize & 0x4000000000000000) != 0u);
+	BufferSize &= 0x3FFFFFFFFFFFFFFF;
 	EncodedData += 8u;
+	EncodedSize -= 8u;
 
 	const unsigned char* RawPtr; 
 	if (bNeedDecode)
+	{
+		unsigned char Codec = GeometryWriter::EncodeOptions::CODEC_LZMA;
+		if (bHasCodec)
+		{
+			Codec = *(EncodedData++);
+			--EncodedSize;
+		}
+
+		TempSrcForDecoding.Resize(BufferSize);
+
+		unsigned long long srcLen = EncodedSize;
+		unsigned long long destLen = TempSrcForDecoding.Size();
+
+		if (!Decompress(Codec, EncodedData, &srcLen, TempSrcForDecoding.Get(), &destLen))
+		{
+			return false;
+		}
+
+		RawPtr = TempSrcForDecoding.Get();
+	}
+	else
+	{
+		RawPtr = EncodedData;
+	}
+
+	if (!Unpack(RawPtr, Space, Scale, Rotation, Position, VertCount, IndCount, Verts, Inds, Alloc, Context, bFloatVerts))
+	{
+		return false;
+	}
+
+	return true;
+}
+
+bool GeometryReader::Decompress(unsigned char Codec, const unsigned char* Src, unsigned long long* SrcLen, unsigned char* Dest, unsigned long long* DestLen)
+{
+	switch (Codec)
+	{
+	case GeometryWriter::EncodeOptions::CODEC_LZMA:
+		{
+#ifdef USE_LZMA2
+			static const unsigned long PropSize = 1u;
+#else
+			static const unsigned long PropSize = LZMA_PROPS_SIZE;
+#endif
+
+			if ((*SrcLen) < PropSize)
+			{
+				__hidden_GeometryIOProcessor::LZMAGetErrorMsg(SZ_ERROR_INPUT_EOF, &ErrorMsg);
+				return false;
+			}
+
+			unsigned long long DataLen = (*SrcLen) - PropSize;
+			if (!DecompressLZMA(Src + PropSize, &DataLen, Src, Dest, DestLen))
+			{
+				return false;
+			}
+
+			(*SrcLen) = PropSize + DataLen;
+			return true;
+		}
+
+	case GeometryWriter::EncodeOptions::CODEC_LZ:
+		if (!__hidden_GeometryIOProcessor::LZDecompress(Src, *SrcLen, Dest, *DestLen, DestLen))
+		{
+			__hidden_GeometryIOProcessor::SetErrorMsg(__hidden_GeometryIOProcessor::ERRPrefixLZ, "corrupted data", &ErrorMsg);
+			return false;
+		}
+		return true;
+
+	default:
+		__hidden_GeometryIOProcessor::SetErrorMsg(__hidden_GeometryIOProcessor::ERRPrefixGeometry, "unknown codec", &ErrorMsg);
+		return false;
+	}
+}
+bool GeometryReader::DecompressLZMA(const unsigned char* Src, unsigned long long* SrcLen, const unsigned char* Prop, unsigned char* Dest, unsigned long long* DestLen)
+{
+	SizeT srcLen = static_cast<SizeT>(*SrcLen);
+	SizeT destLen = static_cast<SizeT>(*DestLen);
+
+	ELzmaStatus status;
+
+#ifdef USE_LZMA2
+	unsigned long ThreadCount = DecodeThreadCount;
+	if (ThreadCount == 0u)
+	{
+		ThreadCount = std::max(std::thread::hardware_concurrency(), 1u);
+	}
+
+	// only payloads this large can hold more than one block, smaller ones stay on the cached single stream decoder
+	if ((ThreadCount > 1u) && (destLen >= (1u << 22u)))
 	{
 		__hidden_GeometryIOProcessor::ISzAllocForGeometry allocator;
 		{
@@ -492,111 +2613,220 @@ bool GeometryReader::Decode(
 			allocator._this = this;
 		}
 
-#ifdef USE_LZMA2
-		static const unsigned long PropSize = 1u;
-#else
-		static const unsigned long PropSize = LZMA_PROPS_SIZE;
-#endif
-		
-		TempSrcForDecoding.Resize(BufferSize);
+		CLzma2DecMtHandle MtDecoder = Lzma2DecMt_Create(&allocator, &allocator);
+		if (!MtDecoder)
+		{
+			__hidden_GeometryIOProcessor::LZMAGetErrorMsg(SZ_ERROR_MEM, &ErrorMsg);
+			return false;
+		}
+
+		CLzma2DecMtProps props;
+		Lzma2DecMtProps_Init(&props);
+		props.numThreads = ThreadCount;
+
+		__hidden_GeometryIOProcessor::LZMA2InStream InStream;
+		{
+			InStream.Read = __hidden_GeometryIOProcessor::LZMA2InStreamRead;
+			InStream.Cur = Src;
+			InStream.Remain = srcLen;
+		}
+		__hidden_GeometryIOProcessor::LZMA2OutStream OutStream;
+		{
+			OutStream.Write = __hidden_GeometryIOProcessor::LZMA2OutStreamWrite;
+			OutStream.Cur = Dest;
+			OutStream.Remain = destLen;
+		}
+
+		const UInt64 OutSize = destLen;
+		UInt64 InProcessed = 0u;
+		int bMT = 0;
+
+		SRes res = Lzma2DecMt_Decode(MtDecoder, (*Prop), &props, &OutStream, &OutSize, 0, &InStream, &InProcessed, &bMT, nullptr);
+		Lzma2DecMt_Destroy(MtDecoder);
+		if (res != SZ_OK)
+		{
+			__hidden_GeometryIOProcessor::LZMAGetErrorMsg(res, &ErrorMsg);
+			return false;
+		}
+
+		(*SrcLen) = InProcessed;
+		(*DestLen) = destLen - OutStream.Remain;
+		return true;
+	}
+
+	// probability tables are kept for the next call and only rebuilt when the property byte changes
+	__hidden_GeometryIOProcessor::LZMA2DecoderState* Decoder = static_cast<__hidden_GeometryIOProcessor::LZMA2DecoderState*>(LZMADecoder);
+	if (Decoder && (Decoder->prop != (*Prop)))
+	{
+		// the tables keep their size across lzma2 dictionary sizes, so this only refreshes the properties
+		SRes res = Lzma2Dec_AllocateProbs(&Decoder->dec, (*Prop), &Decoder->allocator);
+		if (res != SZ_OK)
+		{
+			ReleaseDecoder();
+			__hidden_GeometryIOProcessor::LZMAGetErrorMsg(res, &ErrorMsg);
+			return false;
+		}
+		Decoder->prop = (*Prop);
+	}
+	if (!Decoder)
+	{
+		Decoder = reinterpret_cast<__hidden_GeometryIOProcessor::LZMA2DecoderState*>(CustomAlloc(sizeof(__hidden_GeometryIOProcessor::LZMA2DecoderState)));
+		if (!Decoder)
+		{
+			__hidden_GeometryIOProcessor::LZMAGetErrorMsg(SZ_ERROR_MEM, &ErrorMsg);
+			return false;
+		}
+		{
+			Decoder->allocator.Alloc = __hidden_GeometryIOProcessor::LZMAAlloc;
+			Decoder->allocator.Free = __hidden_GeometryIOProcessor::LZMAFree;
+			Decoder->allocator._this = this;
+		}
 
-		SizeT srcLen = EncodedSize - 8u - PropSize;
-		SizeT destLen = TempSrcForDecoding.Size();
+		Lzma2Dec_Construct(&Decoder->dec);
 
-#ifdef USE_LZMA2
-		ELzmaStatus status;
-		SRes res = __hidden_GeometryIOProcessor::LZMA2Decode(TempSrcForDecoding.Get(), &destLen, EncodedData + PropSize, &srcLen, *EncodedData, LZMA_FINISH_ANY, &status, &allocator);
-#else
-		ELzmaStatus status;
-		SRes res = LzmaDecode(TempSrcForDecoding.Get(), &destLen, EncodedData + PropSize, &srcLen, EncodedData, PropSize, LZMA_FINISH_ANY, &status, &allocator);
-#endif
+		SRes res = Lzma2Dec_AllocateProbs(&Decoder->dec, (*Prop), &Decoder->allocator);
 		if (res != SZ_OK)
 		{
+			CustomFree(Decoder);
 			__hidden_GeometryIOProcessor::LZMAGetErrorMsg(res, &ErrorMsg);
 			return false;
 		}
+		Decoder->prop = (*Prop);
 
-		RawPtr = TempSrcForDecoding.Get();
+		LZMADecoder = Decoder;
 	}
-	else
+
+	// the caller's buffer is used as the dictionary, so the output lands in place
+	Decoder->dec.decoder.dic = Dest;
+	Decoder->dec.decoder.dicBufSize = destLen;
+	Lzma2Dec_Init(&Decoder->dec);
+
+	SRes res = Lzma2Dec_DecodeToDic(&Decoder->dec, destLen, Src, &srcLen, LZMA_FINISH_ANY, &status);
+	destLen = Decoder->dec.decoder.dicPos;
+
+	Decoder->dec.decoder.dic = nullptr;
+	Decoder->dec.decoder.dicBufSize = 0u;
+
+	if (res == SZ_OK && status == LZMA_STATUS_NEEDS_MORE_INPUT)
 	{
-		RawPtr = EncodedData;
+		res = SZ_ERROR_INPUT_EOF;
 	}
-
-	if (!Unpack(RawPtr, Scale, Rotation, Position, VertCount, IndCount))
+#else
+	__hidden_GeometryIOProcessor::ISzAllocForGeometry allocator;
 	{
-		return false;
+		allocator.Alloc = __hidden_GeometryIOProcessor::LZMAAlloc;
+		allocator.Free = __hidden_GeometryIOProcessor::LZMAFree;
+		allocator._this = this;
 	}
 
+	SRes res = LzmaDecode(Dest, &destLen, Src, &srcLen, Prop, LZMA_PROPS_SIZE, LZMA_FINISH_ANY, &status, &allocator);
+#endif
+	if (res != SZ_OK)
 	{
-		unsigned char* Ptr = TempDestForDecoding.Get();
-
-		(*Verts) = reinterpret_cast<double*>(Ptr);
-		Ptr += ((*VertCount) << 3u);
-		(*Inds) =  reinterpret_cast<unsigned long*>(Ptr);
+		__hidden_GeometryIOProcessor::LZMAGetErrorMsg(res, &ErrorMsg);
+		return false;
 	}
 
+	(*SrcLen) = srcLen;
+	(*DestLen) = destLen;
 	return true;
 }
-
+void GeometryReader::ReleaseDecoder()
+{
+#ifdef USE_LZMA2
+	__hidden_GeometryIOProcessor::LZMA2DecoderState* Decoder = static_cast<__hidden_GeometryIOProcessor::LZMA2DecoderState*>(LZMADecoder);
+	if (Decoder)
+	{
+		Lzma2Dec_FreeProbs(&Decoder->dec, &Decoder->allocator);
+		CustomFree(Decoder);
+		LZMADecoder = nullptr;
+	}
+#endif
+}
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 
-bool GeometryWriter::Pack(bool bUseFloat32)
+bool GeometryWriter::Pack(
+	const double* Scale,
+	const double* Rotation,
+	const double* Position,
+	unsigned long VertCount,
+	unsigned long IndCount,
+	const double* Verts,
+	const unsigned long* Inds,
+	bool bUseFloat32
+	)
 {
+	static const unsigned long long HeaderLen = ((3u + 4u + 3u) << 3u) + 4u + 4u + 8u + 8u;
+
+	const bool bConnectivity = (Options.IndexFormat == EncodeOptions::INDEX_CONNECTIVITY);
+
+	const unsigned long ChunkPoints = __hidden_GeometryIOProcessor::VertexChunkPoints(Options, VertCount);
+
+	const bool bQuantize = (Options.MaxVertexError > 0.);
+
+	const unsigned long long VertCapacity = bQuantize ? std::max(PackVertsQuantizedCapacity(VertCount), PackVertsCapacity(VertCount, ChunkPoints)) : PackVertsCapacity(VertCount, ChunkPoints);
+	const unsigned long long IndCapacity = bConnectivity ? std::max(PackIndsConnectivityCapacity(IndCount), PackIndsCapacity(VertCount, IndCount)) : PackIndsCapacity(VertCount, IndCount);
+
+	// packed vertices and indices are written straight behind the header, so size the buffer for the worst case once
+	TempSrcForEncoding.Resize(HeaderLen + VertCapacity + IndCapacity);
+
 	unsigned char* Ptr = TempSrcForEncoding.Get();
 
-	const double* Scale = reinterpret_cast<const double*>(Ptr);
-	Ptr += (3u << 3u);
-	const double* Rotation = reinterpret_cast<const double*>(Ptr);
-	Ptr += (4u << 3u);
-	const double* Position = reinterpret_cast<const double*>(Ptr);
-	Ptr += (3u << 3u);
+	__hidden_GeometryIOProcessor::MemcpyAndMove(Ptr, Scale, 3u << 3u);
+	__hidden_GeometryIOProcessor::MemcpyAndMove(Ptr, Rotation, 4u << 3u);
+	__hidden_GeometryIOProcessor::MemcpyAndMove(Ptr, Position, 3u << 3u);
 
-	const unsigned long VertCount = *reinterpret_cast<unsigned long*>(Ptr);
-	Ptr += 4u;
-	const unsigned long IndCount = *reinterpret_cast<unsigned long*>(Ptr);
-	Ptr += 4u;
+	__hidden_GeometryIOProcessor::MemcpyAndMove(Ptr, &VertCount, 4u);
+	__hidden_GeometryIOProcessor::MemcpyAndMove(Ptr, &IndCount, 4u);
 
-	unsigned long long* PackVertCount = reinterpret_cast<unsigned long long*>(Ptr);
+	unsigned char* PackVertCountPtr = Ptr;
 	Ptr += 8u;
-	unsigned long long* PackIndCount = reinterpret_cast<unsigned long long*>(Ptr);
+	unsigned char* PackIndCountPtr = Ptr;
 	Ptr += 8u;
 
-	unsigned char* Verts = Ptr;
-	Ptr += VertCount << 3u;
-	unsigned char* Inds = Ptr;
+	// vertices the grid can't hold within the error are stored losslessly
+	unsigned long long PackVertCount;
+	if (!bQuantize || !PackVertsQuantized(VertCount, Verts, &PackVertCount, Ptr))
+	{
+		if (!bUseFloat32)
+		{
+			bUseFloat32 = ShouldConvertToFloat(VertCount, IndCount, Verts, Inds);
+		}
+
+		const bool bPlanar = (Options.VertexLayout == EncodeOptions::VERTEX_PLANAR) && ((VertCount % 3u) == 0u);
 
-	if (!bUseFloat32)
+		if (!PackVerts(bUseFloat32, bPlanar, ChunkPoints, VertCount, Verts, &PackVertCount, Ptr, VertCapacity))
+		{
+			return false;
+		}
+	}
+	Ptr += PackVertCount & 0x0FFFFFFFFFFFFFFF;
+
+	unsigned long long PackIndCount = static_cast<unsigned long long>(-1);
+	if (bConnectivity)
 	{
-		bUseFloat32 = ShouldConvertToFloat(VertCount, IndCount, reinterpret_cast<const double*>(Verts), reinterpret_cast<const unsigned long*>(Inds));
+		PackIndsConnectivity(IndCount, Inds, &PackIndCount, Ptr);
 	}
-	
-	if (!PackVerts(bUseFloat32, VertCount, PackVertCount, Verts))
+	if (PackIndCount > PackIndsCapacity(VertCount, IndCount))
 	{
-		return false;
+		PackInds(VertCount, IndCount, Inds, &PackIndCount, Ptr);
 	}
-	PackInds(VertCount, IndCount, PackIndCount, Inds);
-
+	else
 	{
-		const unsigned long long PackVertCountPure =(*PackVertCount) & 0x7FFFFFFFFFFFFFFF; 
-		
-		unsigned char* OldInds = Inds;
-		Inds = Verts + PackVertCountPure;
+		PackIndCount |= 0x8000000000000000;
+	}
 
-		for (unsigned char* EndInds = Inds + (*PackIndCount); Inds < EndInds; ++OldInds, ++Inds)
-		{
-			(*Inds) = (*OldInds);
-		}
+	__hidden_GeometryIOProcessor::Memcpy(PackVertCountPtr, &PackVertCount, 8u);
+	__hidden_GeometryIOProcessor::Memcpy(PackIndCountPtr, &PackIndCount, 8u);
 
-		TempSrcForEncoding.Resize(((3u + 4u + 3u) << 3u) + 4u + 4u + 8u + 8u + PackVertCountPure + (*PackIndCount));
-	}
+	TempSrcForEncoding.Resize(HeaderLen + (PackVertCount & 0x0FFFFFFFFFFFFFFF) + (PackIndCount & 0x7FFFFFFFFFFFFFFF));
 
 	return true;
 }
 
-bool GeometryReader::Unpack(const unsigned char* Ptr, double* Scale, double* Rotation, double* Position, unsigned long* VertCount, unsigned long* IndCount)
+bool GeometryReader::Unpack(const unsigned char* Ptr, DecodeOptions::VertexSpaceType Space, double* Scale, double* Rotation, double* Position, unsigned long* VertCount, unsigned long* IndCount, double** Verts, unsigned long** Inds, DestAlloc Alloc, void* Context, bool bFloatVerts)
 {
 	__hidden_GeometryIOProcessor::Memcpy(Scale, Ptr, 3u << 3u);
 	Ptr += (3u << 3u);
@@ -616,22 +2846,89 @@ bool GeometryReader::Unpack(const unsigned char* Ptr, double* Scale, double* Rot
 	Ptr += 8u;
 
 	const bool bFloatInRange = (PackVertCount & 0x8000000000000000) != 0u;
-	PackVertCount &= 0x7FFFFFFFFFFFFFFF;
+	const bool bPlanar = (PackVertCount & 0x4000000000000000) != 0u;
+	const bool bChunked = (PackVertCount & 0x2000000000000000) != 0u;
+	const bool bQuantized = (PackVertCount & 0x1000000000000000) != 0u;
+	PackVertCount &= 0x0FFFFFFFFFFFFFFF;
+	const bool bConnectivity = (PackIndCount & 0x8000000000000000) != 0u;
+	PackIndCount &= 0x7FFFFFFFFFFFFFFF;
 	
 	const unsigned char* InVerts = Ptr;
 	Ptr += PackVertCount;
 	const unsigned char* InInds = Ptr;
 
-	TempDestForDecoding.Resize(((*VertCount) << 3u) + ((*IndCount) << 2u));
+	__hidden_GeometryIOProcessor::VertexTransform Transform;
+	const __hidden_GeometryIOProcessor::VertexTransform* TransformPtr = nullptr;
+	if (Space != DecodeOptions::VERTEX_LOCAL)
+	{
+		const bool bWorld = (Space == DecodeOptions::VERTEX_WORLD);
+
+		__hidden_GeometryIOProcessor::Memcpy(Transform.Scale, Scale, 3u << 3u);
+		__hidden_GeometryIOProcessor::Memcpy(Transform.Rotation, Rotation, 4u << 3u);
+		for (unsigned long k = 0u; k < 3u; ++k)
+		{
+			// the origin is taken off the position first, so that big coordinates cancel before the local ones are added
+			Transform.Translation[k] = bWorld ? (Position[k] - Options.Origin[k]) : 0.;
+		}
+		Transform.bRotate = bWorld;
+
+		TransformPtr = &Transform;
+	}
+
+	if (Alloc)
+	{
+		if (!Alloc(Context, *VertCount, *IndCount, Verts, Inds))
+		{
+			return false;
+		}
+	}
+	else
+	{
+		const unsigned long long VertBytes = static_cast<unsigned long long>(*VertCount) << (bFloatVerts ? 2u : 3u);
+		TempDestForDecoding.Resize(VertBytes + ((*IndCount) << 2u));
 
-	unsigned char* OutVerts = TempDestForDecoding.Get();
-	unsigned char* OutInds = TempDestForDecoding.Get() + ((*VertCount) << 3u);
+		(*Verts) = reinterpret_cast<double*>(TempDestForDecoding.Get());
+		(*Inds) = reinterpret_cast<unsigned long*>(TempDestForDecoding.Get() + VertBytes);
+	}
 	
-	if (!UnpackVerts(*VertCount, InVerts, bFloatInRange, OutVerts))
+	LastVertexError = 0.;
+	if (bQuantized && bFloatVerts)
+	{
+		// dequantized into doubles aside, then narrowed on the way through the transform
+		TempVertsForDecoding.Resize(static_cast<unsigned long long>(*VertCount) << 3u);
+		if (!UnpackVertsQuantized(*VertCount, InVerts, PackVertCount, TempVertsForDecoding.Get()))
+		{
+			return false;
+		}
+		__hidden_GeometryIOProcessor::TransformInterleaved(TransformPtr, reinterpret_cast<const double*>(TempVertsForDecoding.Get()), reinterpret_cast<float*>(*Verts), *VertCount);
+	}
+	else if (bQuantized)
+	{
+		if (!UnpackVertsQuantized(*VertCount, InVerts, PackVertCount, *Verts))
+		{
+			return false;
+		}
+		if (TransformPtr)
+		{
+			__hidden_GeometryIOProcessor::TransformInterleaved(TransformPtr, *Verts, *Verts, *VertCount);
+		}
+	}
+	else if (!UnpackVerts(*VertCount, InVerts, PackVertCount, bFloatInRange, bPlanar, bChunked, TransformPtr, bFloatVerts, *Verts))
 	{
 		return false;
 	}
-	UnpackInds(*VertCount, *IndCount, InInds, OutInds);
+	if (bConnectivity)
+	{
+		if (!UnpackIndsConnectivity(*IndCount, InInds, PackIndCount, *Inds))
+		{
+			__hidden_GeometryIOProcessor::SetErrorMsg(__hidden_GeometryIOProcessor::ERRPrefixGeometry, "corrupted index stream", &ErrorMsg);
+			return false;
+		}
+	}
+	else
+	{
+		UnpackInds(*VertCount, *IndCount, InInds, *Inds);
+	}
 
 	return true;
 }
@@ -640,266 +2937,676 @@ bool GeometryReader::Unpack(const unsigned char* Ptr, double* Scale, double* Rot
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 
-bool GeometryWriter::ShouldConvertToFloat(unsigned long VertCount, unsigned long IndCount, const double* Verts, const unsigned long* Inds)
+// hashes every position, or with a tolerance its grid cell and the 26 around it, against the vertices kept so far
+bool GeometryWriter::WeldVertices(unsigned long VertCount, unsigned long IndCount, const double* Verts, const unsigned long* Inds, unsigned long* VertexRemap, unsigned long RemapCount)
 {
-	bool bFloatInRange = true;
-	do
+	static const unsigned long Empty = static_cast<unsigned long>(-1);
+
+	if ((VertCount % 3u) != 0u)
+	{
+		return false;
+	}
+
+	const unsigned long PointCount = VertCount / 3u;
+	for (const unsigned long *Src = Inds, *SrcEnd = Inds + IndCount; Src != SrcEnd; ++Src)
 	{
-		for (const double *i = Verts, *e = Verts + VertCount; i != e; ++i)
+		if ((*Src) >= PointCount)
 		{
-			const double CurValue64 = __hidden_GeometryIOProcessor::Abs64(*i);
-			if (CurValue64 <= FLT_MIN)
+			return false;
+		}
+	}
+
+	const double Tolerance = Options.WeldTolerance;
+	const bool bExact = !(Tolerance > 0.);
+	const double InvTolerance = bExact ? 0. : (1. / Tolerance);
+
+	// Cell[3] of a position, the bits of its coordinates when welding exactly. false if it can't be placed on the grid
+	auto ComputeCell = [bExact, InvTolerance](const double* Point, long long* Cell)
+	{
+		for (unsigned long k = 0u; k < 3u; ++k)
+		{
+			if (bExact)
 			{
-				bFloatInRange = false;
-				break;
+				// +0 and -0 compare equal, so they have to hash equal too
+				const double V = (Point[k] == 0.) ? 0. : Point[k];
+				__hidden_GeometryIOProcessor::Memcpy(&Cell[k], &V, 8u);
 			}
-			else if (CurValue64 >= 8796093022208.0)
+			else
 			{
-				bFloatInRange = false;
-				break;	
+				const double V = std::floor(Point[k] * InvTolerance);
+				if (!(std::fabs(V) < 4611686018427387904.))
+				{
+					return false;
+				}
+				Cell[k] = static_cast<long long>(V);
 			}
+		}
+		return true;
+	};
+	auto HashCell = [](const long long* Cell)
+	{
+		unsigned long long Hash = static_cast<unsigned long long>(Cell[0]) * 0x9E3779B97F4A7C15;
+		Hash ^= static_cast<unsigned long long>(Cell[1]) * 0xC2B2AE3D27D4EB4F;
+		Hash ^= static_cast<unsigned long long>(Cell[2]) * 0x165667B19E3779F9;
+		return Hash ^ (Hash >> 29u);
+	};
 
-			const float CurValue32 = static_cast<float>(CurValue64);
+	unsigned long long TableSize = 16u;
+	while (TableSize < (static_cast<unsigned long long>(PointCount) << 1u))
+	{
+		TableSize <<= 1u;
+	}
+	const unsigned long long TableMask = TableSize - 1u;
 
-			const double Diff = __hidden_GeometryIOProcessor::Abs64(CurValue64 - CurValue32);
-			if (Diff <= FLT_EPSILON)
+	// Table[TableSize] of kept vertices | Remap[PointCount]
+	TempTableForEncoding.Resize(TableSize + PointCount);
+
+	unsigned long* Table = TempTableForEncoding.Get();
+	unsigned long* Remap = Table + TableSize;
+	__hidden_GeometryIOProcessor::Memset(Table, Empty, TableSize * sizeof(unsigned long));
+
+	TempVertsForWeld.Resize(VertCount);
+
+	unsigned long KeptCount = 0u;
+	{
+		double* Kept = TempVertsForWeld.Get();
+		for (unsigned long i = 0u; i < PointCount; ++i)
+		{
+			const double* Point = Verts + (static_cast<unsigned long long>(i) * 3u);
+
+			long long Cell[3];
+			const bool bOnGrid = ComputeCell(Point, Cell);
+
+			unsigned long Found = Empty;
+			if (bOnGrid)
 			{
-				bFloatInRange = false;
-				break;
+				const long long Reach = bExact ? 0 : 1;
+				for (long long dz = -Reach; (dz <= Reach) && (Found == Empty); ++dz)
+				{
+					for (long long dy = -Reach; (dy <= Reach) && (Found == Empty); ++dy)
+					{
+						for (long long dx = -Reach; (dx <= Reach) && (Found == Empty); ++dx)
+						{
+							const long long Near[3] = { Cell[0] + dx, Cell[1] + dy, Cell[2] + dz };
+							for (unsigned long long Slot = HashCell(Near) & TableMask; Table[Slot] != Empty; Slot = (Slot + 1u) & TableMask)
+							{
+								const double* Other = Kept + (static_cast<unsigned long long>(Table[Slot]) * 3u);
+
+								long long OtherCell[3];
+								ComputeCell(Other, OtherCell);
+								if ((OtherCell[0] != Near[0]) || (OtherCell[1] != Near[1]) || (OtherCell[2] != Near[2]))
+								{
+									continue;
+								}
+
+								const bool bMatch = bExact
+									? ((Other[0] == Point[0]) && (Other[1] == Point[1]) && (Other[2] == Point[2]))
+									: ((std::fabs(Other[0] - Point[0]) <= Tolerance) && (std::fabs(Other[1] - Point[1]) <= Tolerance) && (std::fabs(Other[2] - Point[2]) <= Tolerance));
+								if (bMatch)
+								{
+									Found = Table[Slot];
+									break;
+								}
+							}
+						}
+					}
+				}
+			}
+
+			if (Found == Empty)
+			{
+				Found = KeptCount++;
+				__hidden_GeometryIOProcessor::Memcpy(Kept + (static_cast<unsigned long long>(Found) * 3u), Point, 3u * sizeof(double));
+
+				if (bOnGrid)
+				{
+					unsigned long long Slot = HashCell(Cell) & TableMask;
+					while (Table[Slot] != Empty)
+					{
+						Slot = (Slot + 1u) & TableMask;
+					}
+					Table[Slot] = Found;
+				}
 			}
+			Remap[i] = Found;
 		}
-		if (!bFloatInRange)
+	}
+
+	if (KeptCount == PointCount)
+	{
+		return false;
+	}
+
+	{
+		TempVertsForWeld.Resize(static_cast<unsigned long long>(KeptCount) * 3u);
+		TempIndsForWeld.Resize(IndCount);
+
+		unsigned long* Dest = TempIndsForWeld.Get();
+		for (const unsigned long *Src = Inds, *SrcEnd = Inds + IndCount; Src != SrcEnd; ++Src, ++Dest)
 		{
-			break;
+			(*Dest) = Remap[*Src];
 		}
 
-		for (const unsigned long *i = Inds, *e = Inds + IndCount; i != e; i += 3u)
+		for (unsigned long i = 0u; i < RemapCount; ++i)
 		{
-			double Magnitude64;
+			VertexRemap[i] = Remap[VertexRemap[i]];
+		}
+	}
+
+	return true;
+}
+// tipsify (Sander et al. 2007). fans around the current vertex, then moves to the adjacent vertex that will still be in the cache when its remaining triangles are emitted
+bool GeometryWriter::ReorderForVertexCache(unsigned long VertCount, unsigned long IndCount, const double* Verts, const unsigned long* Inds, unsigned long* VertexRemap, unsigned long RemapCount)
+{
+	static const unsigned long CacheSize = 16u;
+	static const unsigned long Unassigned = static_cast<unsigned long>(-1);
+
+	if (((VertCount % 3u) != 0u) || ((IndCount % 3u) != 0u))
+	{
+		return false;
+	}
+
+	const unsigned long PointCount = VertCount / 3u;
+	const unsigned long TriCount = IndCount / 3u;
+	for (const unsigned long *Src = Inds, *SrcEnd = Inds + IndCount; Src != SrcEnd; ++Src)
+	{
+		if ((*Src) >= PointCount)
+		{
+			return false;
+		}
+	}
+
+	// Offsets[PointCount + 1] | Adjacency[IndCount] | Live[PointCount] | CacheTime[PointCount] | DeadEnd[IndCount] | Candidates[IndCount] | Emitted[TriCount] | Remap[PointCount]
+	TempTableForEncoding.Resize((static_cast<unsigned long long>(PointCount) << 2u) + 1u + (static_cast<unsigned long long>(IndCount) * 3u) + TriCount);
+
+	unsigned long* Offsets = TempTableForEncoding.Get();
+	unsigned long* Adjacency = Offsets + PointCount + 1u;
+	unsigned long* Live = Adjacency + IndCount;
+	unsigned long* CacheTime = Live + PointCount;
+	unsigned long* DeadEnd = CacheTime + PointCount;
+	unsigned long* Candidates = DeadEnd + IndCount;
+	unsigned long* Emitted = Candidates + IndCount;
+	unsigned long* Remap = Emitted + TriCount;
+
+	{ // triangles around each vertex
+		__hidden_GeometryIOProcessor::Memset(Live, static_cast<unsigned long>(0u), static_cast<unsigned long long>(PointCount) * sizeof(unsigned long));
+		for (const unsigned long *Src = Inds, *SrcEnd = Inds + IndCount; Src != SrcEnd; ++Src)
+		{
+			++Live[*Src];
+		}
+
+		Offsets[0] = 0u;
+		for (unsigned long i = 0u; i < PointCount; ++i)
+		{
+			Offsets[i + 1u] = Offsets[i] + Live[i];
+		}
+
+		__hidden_GeometryIOProcessor::Memcpy(CacheTime, Offsets, static_cast<unsigned long long>(PointCount) * sizeof(unsigned long));
+		for (unsigned long i = 0u; i < IndCount; ++i)
+		{
+			Adjacency[CacheTime[Inds[i]]++] = i / 3u;
+		}
+	}
+
+	{
+		__hidden_GeometryIOProcessor::Memset(CacheTime, static_cast<unsigned long>(0u), static_cast<unsigned long long>(PointCount) * sizeof(unsigned long));
+		__hidden_GeometryIOProcessor::Memset(Emitted, static_cast<unsigned long>(0u), static_cast<unsigned long long>(TriCount) * sizeof(unsigned long));
+		__hidden_GeometryIOProcessor::Memset(Remap, Unassigned, static_cast<unsigned long long>(PointCount) * sizeof(unsigned long));
+		TempIndsForReorder.Resize(IndCount);
+
+		unsigned long* Dest = TempIndsForReorder.Get();
+		unsigned long DeadEndCount = 0u;
+		unsigned long NextPoint = 0u;
+		unsigned long Time = CacheSize + 1u;
+		unsigned long Scan = 0u;
+
+		for (unsigned long Fan = (PointCount > 0u) ? 0u : Unassigned; Fan != Unassigned;)
+		{
+			unsigned long CandidateCount = 0u;
+			for (unsigned long j = Offsets[Fan], jEnd = Offsets[Fan + 1u]; j != jEnd; ++j)
 			{
-				double _0X, _0Y, _0Z;
+				const unsigned long Tri = Adjacency[j];
+				if (Emitted[Tri])
 				{
-					const double* Ptr = Verts + ((*i) * 3u);
-
-					_0X = *Ptr;
-					_0Y = *(Ptr + 1u);
-					_0Z = *(Ptr + 2u);
+					continue;
 				}
+				Emitted[Tri] = 1u;
 
-				double _1X, _1Y, _1Z;
+				for (unsigned long k = 0u; k < 3u; ++k)
 				{
-					const double* Ptr = Verts + ((*(i + 1u)) * 3u);
+					const unsigned long Point = Inds[(Tri * 3u) + k];
 
-					_1X = *Ptr;
-					_1Y = *(Ptr + 1u);
-					_1Z = *(Ptr + 2u);
+					DeadEnd[DeadEndCount++] = Point;
+					Candidates[CandidateCount++] = Point;
+					--Live[Point];
+					if ((Time - CacheTime[Point]) > CacheSize)
+					{
+						CacheTime[Point] = Time++;
+					}
+
+					// renumbered in first use order
+					if (Remap[Point] == Unassigned)
+					{
+						Remap[Point] = NextPoint++;
+					}
+					*(Dest++) = Remap[Point];
 				}
+			}
 
-				double _2X, _2Y, _2Z;
+			Fan = Unassigned;
+			{ // the candidate with the oldest cache entry that survives its remaining triangles
+				unsigned long BestPriority = 0u;
+				for (unsigned long j = 0u; j < CandidateCount; ++j)
 				{
-					const double* Ptr = Verts + ((*(i + 2u)) * 3u);
+					const unsigned long Point = Candidates[j];
+					if (Live[Point] == 0u)
+					{
+						continue;
+					}
 
-					_2X = *Ptr;
-					_2Y = *(Ptr + 1u);
-					_2Z = *(Ptr + 2u);
+					const unsigned long Age = Time - CacheTime[Point];
+					const unsigned long Priority = ((Age + (Live[Point] << 1u)) <= CacheSize) ? (Age + 1u) : 1u;
+					if (Priority > BestPriority)
+					{
+						BestPriority = Priority;
+						Fan = Point;
+					}
 				}
+			}
+			while ((Fan == Unassigned) && (DeadEndCount > 0u))
+			{
+				const unsigned long Point = DeadEnd[--DeadEndCount];
+				Fan = (Live[Point] > 0u) ? Point : Unassigned;
+			}
+			for (; (Fan == Unassigned) && (Scan < PointCount); ++Scan)
+			{
+				Fan = (Live[Scan] > 0u) ? Scan : Unassigned;
+			}
+		}
 
-				const double d0X = _1X - _0X;
-				const double d0Y = _1Y - _0Y;
-				const double d0Z = _1Z - _0Z;
+		// vertices no triangle refers to keep their relative order at the end
+		for (unsigned long i = 0u; i < PointCount; ++i)
+		{
+			if (Remap[i] == Unassigned)
+			{
+				Remap[i] = NextPoint++;
+			}
+		}
+	}
 
-				const double d1X = _2X - _0X;
-				const double d1Y = _2Y - _0Y;
-				const double d1Z = _2Z - _0Z;
+	{
+		TempVertsForReorder.Resize(VertCount);
 
-				const double cX = d0Y * d1Z - d0Z * d1Y;
-				const double cY = d0Z * d1X - d0X * d1Z;
-				const double cZ = d0X * d1Y - d0Y * d1X;
+		double* Dest = TempVertsForReorder.Get();
+		for (unsigned long i = 0u; i < PointCount; ++i)
+		{
+			__hidden_GeometryIOProcessor::Memcpy(Dest + (static_cast<unsigned long long>(Remap[i]) * 3u), Verts + (static_cast<unsigned long long>(i) * 3u), 3u * sizeof(double));
+		}
 
-				double Magnitude = cX * cX + cY * cY + cZ * cZ;
-				Magnitude = __hidden_GeometryIOProcessor::Sqrt64(Magnitude);
-				Magnitude *= 0.5;
+		for (unsigned long i = 0u; i < RemapCount; ++i)
+		{
+			VertexRemap[i] = Remap[VertexRemap[i]];
+		}
+	}
+
+	return true;
+}
+
+bool GeometryWriter::ShouldConvertToFloat(unsigned long VertCount, unsigned long IndCount, const double* Verts, const unsigned long* Inds)
+{
+	const unsigned long long TriCount = IndCount / 3u;
+
+#ifdef USE_AVX2
+	if (__hidden_GeometryIOProcessor::HasAVX2())
+	{
+		return __hidden_GeometryIOProcessor::CoordsFitFloatAVX2(Verts, VertCount) && __hidden_GeometryIOProcessor::TrianglesFitFloatAVX2(Verts, Inds, TriCount);
+	}
+#endif
+#ifdef USE_SSE2
+	return __hidden_GeometryIOProcessor::CoordsFitFloatSSE2(Verts, VertCount) && __hidden_GeometryIOProcessor::TrianglesFitFloatSSE2(Verts, Inds, TriCount);
+#else
+	return __hidden_GeometryIOProcessor::CoordsFitFloat(Verts, VertCount) && __hidden_GeometryIOProcessor::TrianglesFitFloat(Verts, Inds, TriCount);
+#endif
+}
+unsigned long long GeometryWriter::PackVertsCapacity(unsigned long SrcCount, unsigned long ChunkPoints)
+{
+	if (ChunkPoints == 0u)
+	{
+		return 1024u + (static_cast<unsigned long long>(SrcCount) << 3u);
+	}
+
+	const unsigned long long PointCount = SrcCount / 3u;
+	const unsigned long long ChunkCount = (PointCount + ChunkPoints - 1u) / ChunkPoints;
+	return 8u + (ChunkCount * (8u + 1024u)) + (static_cast<unsigned long long>(SrcCount) << 3u);
+}
+unsigned long long GeometryWriter::PackVertsQuantizedCapacity(unsigned long SrcCount)
+{
+	return 40u + (static_cast<unsigned long long>(SrcCount) * 10u);
+}
+// [grid origin 8 * 3][grid step 8][error reached 8][per axis, the zigzag varint level delta of every vertex to the one before]
+bool GeometryWriter::PackVertsQuantized(unsigned long SrcCount, const double* Src, unsigned long long* DestCount, void* Dest)
+{
+	// levels stay exact in a double up to here
+	static const double MaxLevel = 4503599627370496.;
 
-				if (Magnitude <= FLT_MIN)
-				{
-					bFloatInRange = false;
-					break;
-				}
-				else if (Magnitude >= 8796093022208.0)
-				{
-					bFloatInRange = false;
-					break;	
-				}
+	const double MaxError = Options.MaxVertexError;
+	const double Step = MaxError * 2.;
+	if (((SrcCount % 3u) != 0u) || !(Step <= DBL_MAX))
+	{
+		return false;
+	}
 
-				Magnitude64 = Magnitude;
-			}
+	const unsigned long PointCount = SrcCount / 3u;
 
-			float Magnitude32;
+	double Min[3] = { 0., 0., 0. };
+	{
+		double Max[3] = { 0., 0., 0. };
+		if (PointCount > 0u)
+		{
+			__hidden_GeometryIOProcessor::Memcpy(Min, Src, 3u << 3u);
+			__hidden_GeometryIOProcessor::Memcpy(Max, Src, 3u << 3u);
+		}
+		for (const double *i = Src, *e = Src + SrcCount; i != e; i += 3u)
+		{
+			for (unsigned long k = 0u; k < 3u; ++k)
 			{
-				float _0X, _0Y, _0Z;
+				if (!(__hidden_GeometryIOProcessor::Abs64(i[k]) <= DBL_MAX))
 				{
-					const double* Ptr = Verts + ((*i) * 3u);
-
-					_0X = static_cast<float>(*Ptr);
-					_0Y = static_cast<float>(*(Ptr + 1u));
-					_0Z = static_cast<float>(*(Ptr + 2u));
+					return false;
 				}
+				Min[k] = (Min[k] > i[k]) ? i[k] : Min[k];
+				Max[k] = (Max[k] < i[k]) ? i[k] : Max[k];
+			}
+		}
+		for (unsigned long k = 0u; k < 3u; ++k)
+		{
+			if (!(((Max[k] - Min[k]) / Step) < MaxLevel))
+			{
+				return false;
+			}
+		}
+	}
 
-				float _1X, _1Y, _1Z;
-				{
-					const double* Ptr = Verts + ((*(i + 1u)) * 3u);
+	unsigned char* Op = reinterpret_cast<unsigned char*>(Dest);
+	__hidden_GeometryIOProcessor::MemcpyAndMove(Op, Min, 3u << 3u);
+	__hidden_GeometryIOProcessor::MemcpyAndMove(Op, &Step, 8u);
+	unsigned char* ErrorPtr = Op;
+	Op += 8u;
 
-					_1X = static_cast<float>(*Ptr);
-					_1Y = static_cast<float>(*(Ptr + 1u));
-					_1Z = static_cast<float>(*(Ptr + 2u));
-				}
+	double Error = 0.;
+	for (unsigned long k = 0u; k < 3u; ++k)
+	{
+		long long Last = 0;
+		for (unsigned long i = k; i < SrcCount; i += 3u)
+		{
+			const double V = Src[i];
 
-				float _2X, _2Y, _2Z;
+			// the division can round onto the neighbouring level, so settle on whichever of the three reconstructs closest
+			long long Level = static_cast<long long>(std::floor((V - Min[k]) / Step + 0.5));
+			double LevelError = __hidden_GeometryIOProcessor::Abs64((Min[k] + static_cast<double>(Level) * Step) - V);
+			for (long long Near = Level - 1; Near <= Level + 1; Near += 2)
+			{
+				const double NearError = __hidden_GeometryIOProcessor::Abs64((Min[k] + static_cast<double>(Near) * Step) - V);
+				if ((Near >= 0) && (NearError < LevelError))
 				{
-					const double* Ptr = Verts + ((*(i + 2u)) * 3u);
-
-					_2X = static_cast<float>(*Ptr);
-					_2Y = static_cast<float>(*(Ptr + 1u));
-					_2Z = static_cast<float>(*(Ptr + 2u));
+					Level = Near;
+					LevelError = NearError;
 				}
-
-				const float d0X = _1X - _0X;
-				const float d0Y = _1Y - _0Y;
-				const float d0Z = _1Z - _0Z;
-
-				const float d1X = _2X - _0X;
-				const float d1Y = _2Y - _0Y;
-				const float d1Z = _2Z - _0Z;
-
-				const float cX = d0Y * d1Z - d0Z * d1Y;
-				const float cY = d0Z * d1X - d0X * d1Z;
-				const float cZ = d0X * d1Y - d0Y * d1X;
-
-				float Magnitude = cX * cX + cY * cY + cZ * cZ;
-				Magnitude = __hidden_GeometryIOProcessor::Sqrt32(Magnitude);
-				Magnitude *= 0.5f;
-
-				Magnitude32 = Magnitude;
 			}
-
-			const double Diff = __hidden_GeometryIOProcessor::Abs64(Magnitude64 - Magnitude32);
-			if (Diff <= FLT_EPSILON)
+			if (!(LevelError <= MaxError))
 			{
-				bFloatInRange = false;
-				break;
+				return false;
 			}
+			Error = (Error < LevelError) ? LevelError : Error;
+
+			const long long Delta = Level - Last;
+			Op = __hidden_GeometryIOProcessor::WriteVarint(Op, (static_cast<unsigned long long>(Delta) << 1u) ^ static_cast<unsigned long long>(Delta >> 63u));
+			Last = Level;
 		}
 	}
-	while (false);
+	__hidden_GeometryIOProcessor::Memcpy(ErrorPtr, &Error, 8u);
+
+	(*DestCount) = (static_cast<unsigned long long>(Op - reinterpret_cast<unsigned char*>(Dest)) & 0x0FFFFFFFFFFFFFFF) | 0x1000000000000000;
 
-	return bFloatInRange;
+	return true;
 }
-bool GeometryWriter::PackVerts(bool bFloatInRange, unsigned long SrcCount, unsigned long long* DestCount, void* Data)
+bool GeometryWriter::PackVerts(bool bFloatInRange, bool bPlanar, unsigned long ChunkPoints, unsigned long SrcCount, const double* Src, unsigned long long* DestCount, void* Dest, unsigned long long DestCapacity)
 {
-	__hidden_GeometryIOProcessor::FPZIPGeometryIOProcessor = this;
-
-	const double* SrcData = static_cast<const double*>(Data);
-
-	FPZ* fpz;
-	if (bFloatInRange)
+	if (bFloatInRange || bPlanar)
 	{
-		TempDestForEncoding.Resize(1024u + (SrcCount << 2u));
+		TempDestForEncoding.Resize(SrcCount << 3u);
+	}
 
-		const double* Src = reinterpret_cast<const double*>(Data);
-		float* Dest = reinterpret_cast<float*>(Data);
-		for (const double* SrcEnd = reinterpret_cast<const double*>(Data) + SrcCount; Src != SrcEnd; ++Src, ++Dest)
+	unsigned long long outBytes;
+	if (ChunkPoints == 0u)
+	{
+		const fpzipError Err = __hidden_GeometryIOProcessor::FPZIPWriteChunk(this, bFloatInRange, bPlanar, SrcCount, Src, TempDestForEncoding.Get(), Dest, DestCapacity, &outBytes);
+		if (Err != fpzipSuccess)
 		{
-			*Dest = static_cast<float>(*Src);
+			__hidden_GeometryIOProcessor::FPZIPGetErrorMsg(Err, &ErrorMsg);
+			return false;
 		}
-
-		fpz = fpzip_write_to_buffer(TempDestForEncoding.Get(), TempDestForEncoding.Size());
-		fpz->type = FPZIP_TYPE_FLOAT;
 	}
 	else
 	{
-		TempDestForEncoding.Resize(1024u + (SrcCount << 3u));
+		// [points per chunk 4][chunk count 4][chunk sizes 8 * count][chunks]
+		const unsigned long PointCount = SrcCount / 3u;
+		const unsigned long ChunkCount = (PointCount + ChunkPoints - 1u) / ChunkPoints;
 
-		fpz = fpzip_write_to_buffer(TempDestForEncoding.Get(), TempDestForEncoding.Size());
-		fpz->type = FPZIP_TYPE_DOUBLE;
-	}
-	
-	fpz->nx = static_cast<decltype(fpz->nx)>(SrcCount);
-	fpz->ny = 1;
-	fpz->nz = 1;
-	fpz->nf = 1;
+		unsigned char* Ptr = reinterpret_cast<unsigned char*>(Dest);
+		__hidden_GeometryIOProcessor::MemcpyAndMove(Ptr, &ChunkPoints, 4u);
+		__hidden_GeometryIOProcessor::MemcpyAndMove(Ptr, &ChunkCount, 4u);
 
-	bool bRet = true;
-	const size_t outBytes = fpzip_write(fpz, Data);
-	if (fpzip_errno != fpzipSuccess)
-	{
-		bRet = false;
-		__hidden_GeometryIOProcessor::FPZIPGetErrorMsg(fpzip_errno, &ErrorMsg);
-	}
-	
-	fpzip_write_close(fpz);
-	TempDestForEncoding.Resize(outBytes);
+		unsigned long long* ChunkSizes = reinterpret_cast<unsigned long long*>(Ptr);
+		unsigned char* ChunkBegin = Ptr + (static_cast<unsigned long long>(ChunkCount) << 3u);
 
-	if (!bRet)
-	{
-		return false;
+		__hidden_GeometryIOProcessor::TempBuffer<fpzipError> Errors(this);
+		Errors.Resize(ChunkCount, fpzipSuccess);
+
+		unsigned long ThreadCount = Options.ThreadCount;
+		if (ThreadCount == 0u)
+		{
+			ThreadCount = std::max(std::thread::hardware_concurrency(), 1u);
+		}
+
+		// every chunk gets its worst case room, and the results are moved together afterwards
+		__hidden_GeometryIOProcessor::ParallelFor(ChunkCount, ThreadCount, [&](unsigned long long Chunk)
+		{
+			const unsigned long long First = (Chunk * ChunkPoints) * 3u;
+			const unsigned long Count = static_cast<unsigned long>(std::min<unsigned long long>(static_cast<unsigned long long>(ChunkPoints) * 3u, SrcCount - First));
+
+			unsigned long long Size;
+			Errors[Chunk] = __hidden_GeometryIOProcessor::FPZIPWriteChunk(this, bFloatInRange, bPlanar, Count, Src + First, TempDestForEncoding.Get() + (First << 3u), ChunkBegin + (Chunk * 1024u) + (First << 3u), 1024u + (static_cast<unsigned long long>(Count) << 3u), &Size);
+			ChunkSizes[Chunk] = Size;
+		});
+
+		unsigned char* Op = ChunkBegin;
+		for (unsigned long Chunk = 0u; Chunk < ChunkCount; ++Chunk)
+		{
+			if (Errors[Chunk] != fpzipSuccess)
+			{
+				__hidden_GeometryIOProcessor::FPZIPGetErrorMsg(Errors[Chunk], &ErrorMsg);
+				return false;
+			}
+
+			const unsigned long long First = (static_cast<unsigned long long>(Chunk) * ChunkPoints) * 3u;
+			__hidden_GeometryIOProcessor::Memmove(Op, ChunkBegin + (static_cast<unsigned long long>(Chunk) * 1024u) + (First << 3u), ChunkSizes[Chunk]);
+			Op += ChunkSizes[Chunk];
+		}
+
+		outBytes = static_cast<unsigned long long>(Op - reinterpret_cast<unsigned char*>(Dest));
 	}
 	
+	(*DestCount) = outBytes & 0x0FFFFFFFFFFFFFFF;
 	if (bFloatInRange)
 	{
-		__hidden_GeometryIOProcessor::Memcpy(Data, TempDestForEncoding.Get(), TempDestForEncoding.Size());
-		(*DestCount) = static_cast<unsigned long long>(TempDestForEncoding.Size()) | 0x8000000000000000;
+		(*DestCount) |= 0x8000000000000000;
 	}
-	else
+	if (bPlanar)
+	{
+		(*DestCount) |= 0x4000000000000000;
+	}
+	if (ChunkPoints > 0u)
 	{
-		__hidden_GeometryIOProcessor::Memcpy(Data, TempDestForEncoding.Get(), TempDestForEncoding.Size());
-		(*DestCount) = static_cast<unsigned long long>(TempDestForEncoding.Size()) & 0x7FFFFFFFFFFFFFFF;
+		(*DestCount) |= 0x2000000000000000;
 	}
 
 	return true;
 }
 
-bool GeometryReader::UnpackVerts(unsigned long SrcCount, const void* InData, bool bFloatInRange, void* OutData)
+bool GeometryReader::UnpackVertsQuantized(unsigned long SrcCount, const void* InData, unsigned long long InSize, void* OutData)
 {
-	__hidden_GeometryIOProcessor::FPZIPGeometryIOProcessor = this;
+	static const unsigned long long MaxLevel = 1ull << 52u;
 
-	FPZ* fpz = fpzip_read_from_buffer(InData);
+	const unsigned char* Ip = reinterpret_cast<const unsigned char*>(InData);
+	const unsigned char* const IEnd = Ip + InSize;
 
-	if (bFloatInRange)
+	double Min[3];
+	double Step;
+	double Error;
 	{
-		fpz->type = FPZIP_TYPE_FLOAT;
+		if (InSize < 40u)
+		{
+			__hidden_GeometryIOProcessor::SetErrorMsg(__hidden_GeometryIOProcessor::ERRPrefixGeometry, "corrupted vertex grid", &ErrorMsg);
+			return false;
+		}
+		__hidden_GeometryIOProcessor::Memcpy(Min, Ip, 3u << 3u);
+		__hidden_GeometryIOProcessor::Memcpy(&Step, Ip + 24u, 8u);
+		__hidden_GeometryIOProcessor::Memcpy(&Error, Ip + 32u, 8u);
+		Ip += 40u;
 	}
-	else
+
+	double* Dest = reinterpret_cast<double*>(OutData);
+	for (unsigned long k = 0u; k < 3u; ++k)
 	{
-		fpz->type = FPZIP_TYPE_DOUBLE;
+		unsigned long long Level = 0u;
+		for (unsigned long i = k; i < SrcCount; i += 3u)
+		{
+			unsigned long long ZigZag;
+			if (!__hidden_GeometryIOProcessor::ReadVarint(Ip, IEnd, &ZigZag))
+			{
+				__hidden_GeometryIOProcessor::SetErrorMsg(__hidden_GeometryIOProcessor::ERRPrefixGeometry, "corrupted vertex grid", &ErrorMsg);
+				return false;
+			}
+
+			Level += (ZigZag >> 1u) ^ (0u - (ZigZag & 1u));
+			if (Level >= MaxLevel)
+			{
+				__hidden_GeometryIOProcessor::SetErrorMsg(__hidden_GeometryIOProcessor::ERRPrefixGeometry, "corrupted vertex grid", &ErrorMsg);
+				return false;
+			}
+
+			Dest[i] = Min[k] + static_cast<double>(static_cast<long long>(Level)) * Step;
+		}
 	}
-	
-	fpz->nx = static_cast<decltype(fpz->nx)>(SrcCount);
-	fpz->ny = 1;
-	fpz->nz = 1;
-	fpz->nf = 1;
 
-	bool bRet = true;
-	fpzip_read(fpz, OutData);
-	if (fpzip_errno != fpzipSuccess)
+	LastVertexError = Error;
+
+	return true;
+}
+bool GeometryReader::UnpackVerts(unsigned long SrcCount, const void* InData, unsigned long long InSize, bool bFloatInRange, bool bPlanar, bool bChunked, const __hidden_GeometryIOProcessor::VertexTransform* Transform, bool bFloatVerts, void* OutData)
+{
+	// float destinations take fpzip's floats as they are, only doubles read into them go through the scratch buffer
+	if (bPlanar || (bFloatVerts && !bFloatInRange))
 	{
-		bRet = false;
-		__hidden_GeometryIOProcessor::FPZIPGetErrorMsg(fpzip_errno, &ErrorMsg);
+		TempVertsForDecoding.Resize(SrcCount << 3u);
 	}
-	
-	fpzip_read_close(fpz);
 
-	if (!bRet)
+	// decodes Count coordinates from Src into the output from coordinate First on
+	auto ReadChunk = [&](unsigned long Count, const void* Src, unsigned long long First) -> fpzipError
 	{
-		return false;
+		unsigned char* Scratch = TempVertsForDecoding.Get() + (First << 3u);
+		if (bFloatVerts)
+		{
+			return __hidden_GeometryIOProcessor::FPZIPReadChunk(this, bFloatInRange, bPlanar, Count, Src, Scratch, Transform, reinterpret_cast<float*>(OutData) + First);
+		}
+		return __hidden_GeometryIOProcessor::FPZIPReadChunk(this, bFloatInRange, bPlanar, Count, Src, Scratch, Transform, reinterpret_cast<double*>(OutData) + First);
+	};
+
+	if (!bChunked)
+	{
+		const fpzipError Err = ReadChunk(SrcCount, InData, 0u);
+		if (Err != fpzipSuccess)
+		{
+			__hidden_GeometryIOProcessor::FPZIPGetErrorMsg(Err, &ErrorMsg);
+			return false;
+		}
+		return true;
 	}
 
-	if (bFloatInRange)
+	const unsigned char* Ptr = reinterpret_cast<const unsigned char*>(InData);
+
+	unsigned long ChunkPoints;
+	unsigned long ChunkCount;
+	{
+		if (InSize < 8u)
+		{
+			__hidden_GeometryIOProcessor::SetErrorMsg(__hidden_GeometryIOProcessor::ERRPrefixGeometry, "corrupted vertex chunk table", &ErrorMsg);
+			return false;
+		}
+		__hidden_GeometryIOProcessor::Memcpy(&ChunkPoints, Ptr, 4u);
+		__hidden_GeometryIOProcessor::Memcpy(&ChunkCount, Ptr + 4u, 4u);
+		Ptr += 8u;
+		InSize -= 8u;
+
+		const unsigned long PointCount = SrcCount / 3u;
+		if ((ChunkPoints == 0u) || ((SrcCount % 3u) != 0u) || (ChunkCount != ((static_cast<unsigned long long>(PointCount) + ChunkPoints - 1u) / ChunkPoints)) || (InSize < (static_cast<unsigned long long>(ChunkCount) << 3u)))
+		{
+			__hidden_GeometryIOProcessor::SetErrorMsg(__hidden_GeometryIOProcessor::ERRPrefixGeometry, "corrupted vertex chunk table", &ErrorMsg);
+			return false;
+		}
+	}
+
+	// chunk offsets from the size table
+	__hidden_GeometryIOProcessor::TempBuffer<unsigned long long> Offsets(this);
+	{
+		Offsets.Resize(ChunkCount);
+
+		const unsigned long long TableSize = static_cast<unsigned long long>(ChunkCount) << 3u;
+		unsigned long long Offset = TableSize;
+		for (unsigned long Chunk = 0u; Chunk < ChunkCount; ++Chunk)
+		{
+			unsigned long long Size;
+			__hidden_GeometryIOProcessor::Memcpy(&Size, Ptr + (static_cast<unsigned long long>(Chunk) << 3u), 8u);
+			if (Size > (InSize - Offset))
+			{
+				__hidden_GeometryIOProcessor::SetErrorMsg(__hidden_GeometryIOProcessor::ERRPrefixGeometry, "corrupted vertex chunk table", &ErrorMsg);
+				return false;
+			}
+
+			Offsets[Chunk] = Offset;
+			Offset += Size;
+		}
+		if (Offset != InSize)
+		{
+			__hidden_GeometryIOProcessor::SetErrorMsg(__hidden_GeometryIOProcessor::ERRPrefixGeometry, "corrupted vertex chunk table", &ErrorMsg);
+			return false;
+		}
+	}
+
+	__hidden_GeometryIOProcessor::TempBuffer<fpzipError> Errors(this);
+	Errors.Resize(ChunkCount, fpzipSuccess);
+
+	unsigned long ThreadCount = DecodeThreadCount;
+	if (ThreadCount == 0u)
+	{
+		ThreadCount = std::max(std::thread::hardware_concurrency(), 1u);
+	}
+
+	__hidden_GeometryIOProcessor::ParallelFor(ChunkCount, ThreadCount, [&](unsigned long long Chunk)
 	{
-		const float* Src = reinterpret_cast<const float*>(OutData) + SrcCount - 1u;
-		double* Dest = reinterpret_cast<double*>(OutData) + SrcCount - 1u;
-		for (unsigned long i = 0u; i < SrcCount; ++i, --Src, --Dest)
+		const unsigned long long First = (Chunk * ChunkPoints) * 3u;
+		const unsigned long Count = static_cast<unsigned long>(std::min<unsigned long long>(static_cast<unsigned long long>(ChunkPoints) * 3u, SrcCount - First));
+
+		Errors[Chunk] = ReadChunk(Count, Ptr + Offsets[Chunk], First);
+	});
+
+	for (unsigned long Chunk = 0u; Chunk < ChunkCount; ++Chunk)
+	{
+		if (Errors[Chunk] != fpzipSuccess)
 		{
-			(*Dest) = static_cast<double>(*Src);
+			__hidden_GeometryIOProcessor::FPZIPGetErrorMsg(Errors[Chunk], &ErrorMsg);
+			return false;
 		}
 	}
 
@@ -910,7 +3617,7 @@ bool GeometryReader::UnpackVerts(unsigned long SrcCount, const void* InData, boo
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 
-void GeometryWriter::PackInds(unsigned long VertCount, unsigned long SrcCount, unsigned long long* DestCount, void* Data)
+unsigned long long GeometryWriter::PackIndsCapacity(unsigned long VertCount, unsigned long SrcCount)
 {
 	unsigned long RequireBitsPerSingle = 0u;
 	{
@@ -925,26 +3632,121 @@ void GeometryWriter::PackInds(unsigned long VertCount, unsigned long SrcCount, u
 	unsigned long long TotalRequireBits = RequireBitsPerSingle;
 	TotalRequireBits *= SrcCount;
 
-	const unsigned long long TotalRequireBytes = (TotalRequireBits + 7u) >> 3u;
+	return (TotalRequireBits + 7u) >> 3u;
+}
+void GeometryWriter::PackInds(unsigned long VertCount, unsigned long SrcCount, const unsigned long* Src, unsigned long long* DestCount, void* Dest)
+{
+	unsigned long RequireBitsPerSingle = 0u;
+	{
+		long long i = VertCount;
+		while (i > 0u)
+		{
+			i >>= 1u;
+			++RequireBitsPerSingle;
+		}
+	}
+
+	const unsigned long long TotalRequireBytes = PackIndsCapacity(VertCount, SrcCount);
+	const unsigned long long Mask = (1ull << RequireBitsPerSingle) - 1u;
 
-	TempDestForEncoding.Resize(TotalRequireBytes, 0u);
+	// bits go out least significant first, 32 at a time through an accumulator
+	unsigned char* DestBytes = static_cast<unsigned char*>(Dest);
+	unsigned long long Acc = 0u;
+	unsigned long AccBits = 0u;
 
-	unsigned long long BitOffset = 0u;
-	const unsigned long* SrcIndPtr = static_cast<const unsigned long*>(Data);
-	const unsigned long* SrcIndEndPtr = static_cast<const unsigned long*>(Data) + SrcCount;
-	for (unsigned long j = 0u; SrcIndPtr != SrcIndEndPtr; ++SrcIndPtr, ++j)
+	const unsigned long* SrcIndPtr = Src;
+	const unsigned long* SrcIndEndPtr = Src + SrcCount;
+#ifdef USE_BMI2
+	if ((sizeof(unsigned long) == 4u) && (RequireBitsPerSingle > 0u) && (RequireBitsPerSingle <= 16u) && __hidden_GeometryIOProcessor::HasFastBMI2())
 	{
-		const unsigned long SrcInd = (*SrcIndPtr);
-		for (unsigned long i = 0u; i < RequireBitsPerSingle; ++i)
+		SrcIndPtr = __hidden_GeometryIOProcessor::PackIndsBMI2(RequireBitsPerSingle, SrcIndPtr, SrcIndEndPtr, &DestBytes, &Acc, &AccBits);
+	}
+#endif
+	for (; SrcIndPtr != SrcIndEndPtr; ++SrcIndPtr)
+	{
+		Acc |= (static_cast<unsigned long long>(*SrcIndPtr) & Mask) << AccBits;
+		AccBits += RequireBitsPerSingle;
+		if (AccBits >= 32u)
 		{
-			const unsigned long long CurBit = (SrcInd >> i) & 1u;
-			TempDestForEncoding[BitOffset >> 3] |= (CurBit << (BitOffset & 7u));
-			++BitOffset;
+			__hidden_GeometryIOProcessor::MemcpyAndMove(DestBytes, &Acc, 4u);
+			Acc >>= 32u;
+			AccBits -= 32u;
 		}
 	}
+	__hidden_GeometryIOProcessor::Memcpy(DestBytes, &Acc, (AccBits + 7u) >> 3u);
 	
-	(*DestCount) = static_cast<unsigned long long>(TempDestForEncoding.Size());
-	__hidden_GeometryIOProcessor::Memcpy(Data, TempDestForEncoding.Get(), TempDestForEncoding.Size());
+	(*DestCount) = TotalRequireBytes;
+}
+unsigned long long GeometryWriter::PackIndsConnectivityCapacity(unsigned long SrcCount)
+{
+	// a triangle takes at most one byte and three 5 byte vertex codes
+	return (static_cast<unsigned long long>(SrcCount) * 6u) + 16u;
+}
+void GeometryWriter::PackIndsConnectivity(unsigned long SrcCount, const unsigned long* Src, unsigned long long* DestCount, void* Dest)
+{
+	__hidden_GeometryIOProcessor::TriangleCodecState State;
+	__hidden_GeometryIOProcessor::TriangleCodecInit(&State);
+
+	unsigned char* Op = static_cast<unsigned char*>(Dest);
+
+	const unsigned long* SrcIndPtr = Src;
+	for (const unsigned long* SrcTriEndPtr = Src + (SrcCount - (SrcCount % 3u)); SrcIndPtr != SrcTriEndPtr; SrcIndPtr += 3)
+	{
+		// prefer the youngest edge, trying every rotation of the triangle against it
+		unsigned long HitAge = 16u;
+		unsigned long HitRotation = 0u;
+		for (unsigned long Age = 0u; (Age < 16u) && (HitAge == 16u); ++Age)
+		{
+			const unsigned long* Edge = __hidden_GeometryIOProcessor::TriangleCodecEdge(&State, Age);
+			for (unsigned long Rotation = 0u; Rotation < 3u; ++Rotation)
+			{
+				if ((Edge[0] == SrcIndPtr[(Rotation + 1u) % 3u]) && (Edge[1] == SrcIndPtr[Rotation]))
+				{
+					HitAge = Age;
+					HitRotation = Rotation;
+					break;
+				}
+			}
+		}
+
+		if (HitAge < 16u)
+		{
+			const unsigned long X = SrcIndPtr[HitRotation];
+			const unsigned long Y = SrcIndPtr[(HitRotation + 1u) % 3u];
+			const unsigned long Z = SrcIndPtr[(HitRotation + 2u) % 3u];
+
+			if (Z == State.Next)
+			{
+				*(Op++) = static_cast<unsigned char>(0xC0 | (HitRotation << 4u) | HitAge);
+				__hidden_GeometryIOProcessor::TriangleCodecVisit(&State, Z, false);
+			}
+			else
+			{
+				*(Op++) = static_cast<unsigned char>(0x80 | (HitRotation << 4u) | HitAge);
+				Op = __hidden_GeometryIOProcessor::WriteVertexCode(&State, Op, Z);
+			}
+
+			__hidden_GeometryIOProcessor::TriangleCodecPushEdge(&State, Y, Z);
+			__hidden_GeometryIOProcessor::TriangleCodecPushEdge(&State, Z, X);
+		}
+		else
+		{
+			*(Op++) = 0x00;
+			Op = __hidden_GeometryIOProcessor::WriteVertexCode(&State, Op, SrcIndPtr[0]);
+			Op = __hidden_GeometryIOProcessor::WriteVertexCode(&State, Op, SrcIndPtr[1]);
+			Op = __hidden_GeometryIOProcessor::WriteVertexCode(&State, Op, SrcIndPtr[2]);
+
+			__hidden_GeometryIOProcessor::TriangleCodecPushEdge(&State, SrcIndPtr[0], SrcIndPtr[1]);
+			__hidden_GeometryIOProcessor::TriangleCodecPushEdge(&State, SrcIndPtr[1], SrcIndPtr[2]);
+			__hidden_GeometryIOProcessor::TriangleCodecPushEdge(&State, SrcIndPtr[2], SrcIndPtr[0]);
+		}
+	}
+	for (const unsigned long* SrcIndEndPtr = Src + SrcCount; SrcIndPtr != SrcIndEndPtr; ++SrcIndPtr)
+	{
+		Op = __hidden_GeometryIOProcessor::WriteVertexCode(&State, Op, *SrcIndPtr);
+	}
+
+	(*DestCount) = static_cast<unsigned long long>(Op - static_cast<unsigned char*>(Dest));
 }
 
 void GeometryReader::UnpackInds(unsigned long VertCount, unsigned long SrcCount, const void* InData, void* OutData)
@@ -958,21 +3760,111 @@ void GeometryReader::UnpackInds(unsigned long VertCount, unsigned long SrcCount,
 			++RequireBitsPerSingle;
 		}
 	}
-
-	unsigned long long BitOffset = 0u;
-	unsigned long* DestIndPtr = reinterpret_cast<unsigned long*>(OutData);
-	const unsigned long* DestIndEndPtr = reinterpret_cast<const unsigned long*>(OutData) + SrcCount;
-	for (unsigned long j = 0u; DestIndPtr != DestIndEndPtr; ++DestIndPtr, ++j)
+
+	const unsigned char* InBytes = reinterpret_cast<const unsigned char*>(InData);
+	const unsigned long long InLen = ((static_cast<unsigned long long>(RequireBitsPerSingle) * SrcCount) + 7u) >> 3u;
+	const unsigned long long Mask = (1ull << RequireBitsPerSingle) - 1u;
+
+	unsigned long* DestInds = reinterpret_cast<unsigned long*>(OutData);
+
+	unsigned long long j = 0u;
+#ifdef USE_BMI2
+	if ((sizeof(unsigned long) == 4u) && (RequireBitsPerSingle > 0u) && (RequireBitsPerSingle <= 28u) && __hidden_GeometryIOProcessor::HasFastBMI2())
+	{
+		j = __hidden_GeometryIOProcessor::UnpackIndsBMI2(RequireBitsPerSingle, SrcCount, InBytes, InLen, DestInds);
+	}
+#endif
+	// an 8 byte window holds an index at any bit phase. near the end it's filled from whatever bytes are left
+	for (; j < SrcCount; ++j)
+	{
+		const unsigned long long BitOffset = j * RequireBitsPerSingle;
+		const unsigned long long ByteOffset = BitOffset >> 3u;
+
+		unsigned long long Window = 0u;
+		__hidden_GeometryIOProcessor::Memcpy(&Window, InBytes + ByteOffset, std::min<unsigned long long>(InLen - ByteOffset, 8u));
+
+		DestInds[j] = static_cast<unsigned long>((Window >> (BitOffset & 7u)) & Mask);
+	}
+}
+bool GeometryReader::UnpackIndsConnectivity(unsigned long SrcCount, const void* InData, unsigned long long InSize, void* OutData)
+{
+	__hidden_GeometryIOProcessor::TriangleCodecState State;
+	__hidden_GeometryIOProcessor::TriangleCodecInit(&State);
+
+	const unsigned char* Ip = reinterpret_cast<const unsigned char*>(InData);
+	const unsigned char* const IEnd = Ip + InSize;
+
+	unsigned long* DestIndPtr = reinterpret_cast<unsigned long*>(OutData);
+	for (const unsigned long* DestTriEndPtr = DestIndPtr + (SrcCount - (SrcCount % 3u)); DestIndPtr != DestTriEndPtr; DestIndPtr += 3)
+	{
+		if (Ip >= IEnd)
+		{
+			return false;
+		}
+		const unsigned char Code = *(Ip++);
+
+		if ((Code & 0x80) != 0u)
+		{
+			const unsigned long Rotation = (Code >> 4u) & 3u;
+			if (Rotation == 3u)
+			{
+				return false;
+			}
+
+			const unsigned long* Edge = __hidden_GeometryIOProcessor::TriangleCodecEdge(&State, Code & 0x0F);
+			const unsigned long X = Edge[1];
+			const unsigned long Y = Edge[0];
+
+			unsigned long Z;
+			if ((Code & 0x40) != 0u)
+			{
+				if (State.Next > 0xFFFFFFFF)
+				{
+					return false;
+				}
+				Z = static_cast<unsigned long>(State.Next);
+				__hidden_GeometryIOProcessor::TriangleCodecVisit(&State, Z, false);
+			}
+			else if (!__hidden_GeometryIOProcessor::ReadVertexCode(&State, Ip, IEnd, &Z))
+			{
+				return false;
+			}
+
+			DestIndPtr[Rotation] = X;
+			DestIndPtr[(Rotation + 1u) % 3u] = Y;
+			DestIndPtr[(Rotation + 2u) % 3u] = Z;
+
+			__hidden_GeometryIOProcessor::TriangleCodecPushEdge(&State, Y, Z);
+			__hidden_GeometryIOProcessor::TriangleCodecPushEdge(&State, Z, X);
+		}
+		else
+		{
+			if (Code != 0x00)
+			{
+				return false;
+			}
+			for (unsigned long i = 0u; i < 3u; ++i)
+			{
+				if (!__hidden_GeometryIOProcessor::ReadVertexCode(&State, Ip, IEnd, DestIndPtr + i))
+				{
+					return false;
+				}
+			}
+
+			__hidden_GeometryIOProcessor::TriangleCodecPushEdge(&State, DestIndPtr[0], DestIndPtr[1]);
+			__hidden_GeometryIOProcessor::TriangleCodecPushEdge(&State, DestIndPtr[1], DestIndPtr[2]);
+			__hidden_GeometryIOProcessor::TriangleCodecPushEdge(&State, DestIndPtr[2], DestIndPtr[0]);
+		}
+	}
+	for (const unsigned long* DestIndEndPtr = reinterpret_cast<const unsigned long*>(OutData) + SrcCount; DestIndPtr != DestIndEndPtr; ++DestIndPtr)
 	{
-		unsigned long long CurInd = 0u;
-		for (unsigned long i = 0u; i < RequireBitsPerSingle; ++i)
+		if (!__hidden_GeometryIOProcessor::ReadVertexCode(&State, Ip, IEnd, DestIndPtr))
 		{
-			const unsigned long long CurBit = (reinterpret_cast<const unsigned char*>(InData)[BitOffset >> 3u] >> (BitOffset & 7u)) & 1u;
-			CurInd |= CurBit << i;
-			++BitOffset;
+			return false;
 		}
-		(*DestIndPtr) = static_cast<unsigned long>(CurInd);
 	}
+
+	return true;
 }
 
 
@@ -1008,10 +3900,39 @@ bool GeometryStreamWriter::BeginWrite(void* _Handle)
 
 bool GeometryStreamReader::BeginRead(void* _Handle)
 {
-	if (Handle)
+	if (Handle || MappedData)
+	{
+		return false;
+	}
+
+	// a failed open leaves nothing behind, so the reader can be opened again without EndRead
+	if (!BeginReadStream(_Handle))
 	{
+		ResetRead();
 		return false;
 	}
+
+	return true;
+}
+
+bool GeometryStreamReader::BeginRead(const void* Data, unsigned long long Size, unsigned long long Offset)
+{
+	if (Handle || MappedData)
+	{
+		return false;
+	}
+
+	if (!BeginReadMapped(Data, Size, Offset))
+	{
+		ResetRead();
+		return false;
+	}
+
+	return true;
+}
+
+bool GeometryStreamReader::BeginReadStream(void* _Handle)
+{
 	Handle = _Handle;
 
 	unsigned long long HeaderPos = static_cast<unsigned long long>(-1);
@@ -1024,21 +3945,20 @@ bool GeometryStreamReader::BeginRead(void* _Handle)
 		return false;
 	}
 
-	const bool bEncodedHeader = ((HeaderPos & 0x8000000000000000) != 0u);
-	HeaderPos &= 0x7FFFFFFFFFFFFFFF;
+	const unsigned long long HeaderFlags = HeaderPos & 0xF800000000000000;
+	HeaderPos &= 0x07FFFFFFFFFFFFFF;
 	if (!CustomJump(Handle, HeaderPos))
 	{
 		return false;
 	}
 
 	{
-		if (bEncodedHeader)
+		if ((HeaderFlags & 0x8000000000000000) != 0u)
 		{
-			__hidden_GeometryIOProcessor::ISzAllocForGeometry allocator;
+			unsigned long PreHeader[2];
+			if (!CustomRead(Handle, sizeof(PreHeader), PreHeader))
 			{
-				allocator.Alloc = __hidden_GeometryIOProcessor::LZMAAlloc;
-				allocator.Free = __hidden_GeometryIOProcessor::LZMAFree;
-				allocator._this = this;
+				return false;
 			}
 
 #ifdef USE_LZMA2
@@ -1046,137 +3966,388 @@ bool GeometryStreamReader::BeginRead(void* _Handle)
 #else
 			static const unsigned long PropSize = LZMA_PROPS_SIZE;
 #endif
-			
-			struct
-			{
-				unsigned long DestSize;
-				unsigned long SrcSize;
-				unsigned char Prop[PropSize];
-			}
-			PreHeader;
-			if (!CustomRead(Handle, 8u + PropSize, &PreHeader))
+
+			// a codec byte replaces the lzma properties, whose size is then counted in PreHeader[1]
+			const unsigned long long PrefixSize = ((HeaderFlags & 0x0800000000000000) != 0u) ? 1u : PropSize;
+
+			Temporal.Resize(sizeof(PreHeader) + PrefixSize + PreHeader[1]);
+			__hidden_GeometryIOProcessor::Memcpy(Temporal.Get(), PreHeader, sizeof(PreHeader));
+			if (!CustomRead(Handle, PrefixSize + PreHeader[1], Temporal.Get() + sizeof(PreHeader)))
 			{
 				return false;
 			}
 
-			Temporal.Resize(PreHeader.SrcSize + PreHeader.DestSize);
-			if (!CustomRead(Handle, PreHeader.SrcSize, Temporal.Get()))
+			if (!DecodeHeader(Temporal.Get(), Temporal.Size(), HeaderFlags))
 			{
 				return false;
 			}
-
-			SizeT SrcLen = PreHeader.SrcSize;
-			SizeT DestLen = PreHeader.DestSize;
-			
-			unsigned char* PtrSrc = Temporal.Get();
-			unsigned char* PtrDest = Temporal.Get() + PreHeader.SrcSize;
-
-#ifdef USE_LZMA2
-			ELzmaStatus status;
-			SRes res = __hidden_GeometryIOProcessor::LZMA2Decode(PtrDest, &DestLen, PtrSrc, &SrcLen, PreHeader.Prop[0], LZMA_FINISH_ANY, &status, &allocator);
-#else
-			ELzmaStatus status;
-			SRes res = LzmaDecode(PtrDest, &DestLen, PtrSrc, &SrcLen, PreHeader.Prop, PropSize, LZMA_FINISH_ANY, &status, &allocator);
-#endif
-			if (res != SZ_OK)
+		}
+		else
+		{
+			GeometryCount = static_cast<unsigned long long>(-1);
+			if (!CustomRead(Handle, sizeof(GeometryCount), &GeometryCount))
 			{
-				__hidden_GeometryIOProcessor::LZMAGetErrorMsg(res, &ErrorMsg);
 				return false;
 			}
 
-			unsigned long long GeometryCount;
-			__hidden_GeometryIOProcessor::Memcpy(&GeometryCount, PtrDest, sizeof(GeometryCount));
-			PtrDest += sizeof(GeometryCount);
-
 			if (GeometryCount == static_cast<unsigned long long>(-1))
 			{
 				return false;
 			}
 
-			HeaderNames.Resize(GeometryCount);
-			HeaderMinMaxes.Resize(GeometryCount);
+			if ((HeaderFlags & 0x1000000000000000) != 0u)
+			{
+				unsigned long long NameLength = 0u;
+				if (!CustomRead(Handle, sizeof(NameLength), &NameLength))
+				{
+					return false;
+				}
 
-			HeaderRawNames.Resize(GeometryCount << 1u);
-			HeaderRawNames.Resize(0u);
-			for (unsigned long long i = 0u; i < GeometryCount; ++i)
+				HeaderRawNames.Resize(NameLength);
+				if (!CustomRead(Handle, NameLength * sizeof(wchar_t), HeaderRawNames.Get()))
+				{
+					return false;
+				}
+			}
+			else
 			{
-				wchar_t Chr = 0;
-				do
+				HeaderRawNames.Resize(0u);
+				HeaderRawNames.Reserve(std::min(GeometryCount, 1ull << 16u) << 1u);
+				for (unsigned long long i = 0u; i < GeometryCount; ++i)
 				{
-					__hidden_GeometryIOProcessor::Memcpy(&Chr, PtrDest, sizeof(Chr));
-					PtrDest += sizeof(Chr);
+					wchar_t Chr = 0;
+					do
+					{
+						if (!CustomRead(Handle, sizeof(Chr), &Chr))
+						{
+							return false;
+						}
 
-					HeaderRawNames.Resize(HeaderRawNames.Size() + 1u);
-					HeaderRawNames[HeaderRawNames.Size() - 1u] = Chr;
+						HeaderRawNames.Append(&Chr, 1u);
+					}
+					while (Chr != 0);
 				}
-				while (Chr != 0);
 			}
 
-			__hidden_GeometryIOProcessor::Memcpy(HeaderMinMaxes.Get(), PtrDest, GeometryCount * sizeof(__hidden_GeometryIOProcessor::MinMax));
-		}
-		else
-		{
-			unsigned long long GeometryCount = static_cast<unsigned long long>(-1);
-			if (!CustomRead(Handle, sizeof(GeometryCount), &GeometryCount))
+			// every name takes at least its terminator, so the names actually read bound the count before it sizes anything
+			if (GeometryCount > HeaderRawNames.Size())
 			{
 				return false;
 			}
 
-			if (GeometryCount == static_cast<unsigned long long>(-1))
+			HeaderNames.Resize(GeometryCount);
+			HeaderMinMaxes.Resize(GeometryCount);
+			HeaderLocations.Resize(GeometryCount);
+
+			if (!__hidden_GeometryIOProcessor::ScanNames(HeaderRawNames.Get(), HeaderRawNames.Get() + HeaderRawNames.Size(), GeometryCount, HeaderNames.Get()))
 			{
 				return false;
 			}
 
-			HeaderNames.Resize(GeometryCount);
-			HeaderMinMaxes.Resize(GeometryCount);
+			if (!CustomRead(Handle, GeometryCount * sizeof(__hidden_GeometryIOProcessor::MinMax), HeaderMinMaxes.Get()))
+			{
+				return false;
+			}
+			MinMaxView = HeaderMinMaxes.Get();
+
+			if ((HeaderFlags & 0x4000000000000000) != 0u)
+			{
+				if (!CustomRead(Handle, GeometryCount * sizeof(__hidden_GeometryIOProcessor::Location), HeaderLocations.Get()))
+				{
+					return false;
+				}
+				LocationView = HeaderLocations.Get();
+			}
 
-			HeaderRawNames.Resize(GeometryCount << 1u);
-			HeaderRawNames.Resize(0u);
-			for (unsigned long long i = 0u; i < GeometryCount; ++i)
+			if ((HeaderFlags & 0x2000000000000000) != 0u)
 			{
-				wchar_t Chr = 0;
-				do
+				unsigned long BucketCount;
+				if (!CustomRead(Handle, sizeof(BucketCount), &BucketCount))
 				{
-					if (!CustomRead(Handle, sizeof(Chr), &Chr))
+					return false;
+				}
+
+				// the writer never stores more than four buckets per geometry, anything bigger is left unread and rebuilt below
+				if (BucketCount <= (GeometryCount << 2u))
+				{
+					HeaderNameTable.Resize(BucketCount);
+					if (!CustomRead(Handle, BucketCount * sizeof(unsigned long), HeaderNameTable.Get()))
 					{
 						return false;
 					}
 
-					HeaderRawNames.Resize(HeaderRawNames.Size() + 1u);
-					HeaderRawNames[HeaderRawNames.Size() - 1u] = Chr;
+					if (__hidden_GeometryIOProcessor::CheckNameTable(HeaderNameTable.Get(), BucketCount, GeometryCount))
+					{
+						NameTableView = HeaderNameTable.Get();
+						NameTableSize = BucketCount;
+					}
 				}
-				while (Chr != 0);
 			}
+		}
+	}
 
-			if (!CustomRead(Handle, GeometryCount * sizeof(__hidden_GeometryIOProcessor::MinMax), HeaderMinMaxes.Get()))
+	if (!NameTableView)
+	{
+		BuildNameTable();
+	}
+
+	if (!LocationView)
+	{
+		// older archives have no location table, so build it with a single walk over the payloads
+		HeaderLocations.Resize(GeometryCount);
+		
+		unsigned long long Pos = FileBegin;
+		for (__hidden_GeometryIOProcessor::Location *Ptr = HeaderLocations.Get(), *PtrEnd = HeaderLocations.Get() + HeaderLocations.Size(); Ptr != PtrEnd; ++Ptr)
+		{
+			if (!CustomJump(Handle, Pos))
+			{
+				return false;
+			}
+			if (!CustomRead(Handle, sizeof(Ptr->Size), &Ptr->Size))
+			{
+				return false;
+			}
+
+			Ptr->Position = Pos + sizeof(Ptr->Size);
+			if (Ptr->Size > (static_cast<unsigned long long>(-1) - Ptr->Position))
 			{
 				return false;
-			}			
+			}
+			Pos = Ptr->Position + Ptr->Size;
 		}
+		LocationView = HeaderLocations.Get();
+	}
+
+	if (!CustomJump(Handle, FileBegin))
+	{
+		return false;
+	}
+
+	return true;
+}
+
+bool GeometryStreamReader::BeginReadMapped(const void* Data, unsigned long long Size, unsigned long long Offset)
+{
+	MappedData = static_cast<const unsigned char*>(Data);
+	MappedSize = Size;
+
+	unsigned long long HeaderPos = static_cast<unsigned long long>(-1);
+	if ((MappedSize < sizeof(HeaderPos)) || (Offset > (MappedSize - sizeof(HeaderPos))))
+	{
+		return false;
+	}
+	__hidden_GeometryIOProcessor::Memcpy(&HeaderPos, MappedData + Offset, sizeof(HeaderPos));
+	FileBegin = Offset + sizeof(HeaderPos);
+
+	const unsigned long long HeaderFlags = HeaderPos & 0xF800000000000000;
+	HeaderPos &= 0x07FFFFFFFFFFFFFF;
+	if (HeaderPos > MappedSize)
+	{
+		return false;
+	}
 
+	if ((HeaderFlags & 0x8000000000000000) != 0u)
+	{
+		if (!DecodeHeader(MappedData + HeaderPos, MappedSize - HeaderPos, HeaderFlags))
 		{
-			static const wchar_t Dummy = 0;
-			
-			const wchar_t** Names = HeaderNames.Get();
-			for (const wchar_t *PtrPrev = &Dummy, *Ptr = HeaderRawNames.Get(), *PtrEnd = HeaderRawNames.Get() + HeaderRawNames.Size(); Ptr != PtrEnd; PtrPrev = Ptr, ++Ptr)
+			return false;
+		}
+	}
+	else
+	{
+		if (!ParseHeader(MappedData + HeaderPos, MappedSize - HeaderPos, HeaderFlags))
+		{
+			return false;
+		}
+	}
+
+	if (!NameTableView)
+	{
+		BuildNameTable();
+	}
+
+	if (!LocationView)
+	{
+		// older archives have no location table, so build it with a single walk over the payloads
+		HeaderLocations.Resize(GeometryCount);
+		
+		unsigned long long Pos = FileBegin;
+		for (__hidden_GeometryIOProcessor::Location *Ptr = HeaderLocations.Get(), *PtrEnd = HeaderLocations.Get() + HeaderLocations.Size(); Ptr != PtrEnd; ++Ptr)
+		{
+			if ((MappedSize < sizeof(Ptr->Size)) || (Pos > (MappedSize - sizeof(Ptr->Size))))
 			{
-				if ((*PtrPrev) == 0)
-				{
-					(*Names) = Ptr;
-					++Names;
-				}
+				return false;
+			}
+			__hidden_GeometryIOProcessor::Memcpy(&Ptr->Size, MappedData + Pos, sizeof(Ptr->Size));
+
+			Ptr->Position = Pos + sizeof(Ptr->Size);
+			if (Ptr->Size > (MappedSize - Ptr->Position))
+			{
+				return false;
 			}
+			Pos = Ptr->Position + Ptr->Size;
 		}
+		LocationView = HeaderLocations.Get();
 	}
 
-	if (!CustomJump(Handle, FileBegin))
+	return true;
+}
+
+
+bool GeometryStreamReader::DecodeHeader(const unsigned char* Ptr, unsigned long long Size, unsigned long long HeaderFlags)
+{
+#ifdef USE_LZMA2
+	static const unsigned long PropSize = 1u;
+#else
+	static const unsigned long PropSize = LZMA_PROPS_SIZE;
+#endif
+	
+	struct
+	{
+		unsigned long DestSize;
+		unsigned long SrcSize;
+	}
+	PreHeader;
+	if (Size < sizeof(PreHeader))
+	{
+		return false;
+	}
+	__hidden_GeometryIOProcessor::Memcpy(&PreHeader, Ptr, sizeof(PreHeader));
+	Ptr += sizeof(PreHeader);
+	Size -= sizeof(PreHeader);
+
+	unsigned char Codec = GeometryWriter::EncodeOptions::CODEC_LZMA;
+	unsigned long long SrcLen = PropSize + static_cast<unsigned long long>(PreHeader.SrcSize);
+	if ((HeaderFlags & 0x0800000000000000) != 0u)
+	{
+		if (Size < 1u)
+		{
+			return false;
+		}
+		Codec = *(Ptr++);
+		--Size;
+
+		SrcLen = PreHeader.SrcSize;
+	}
+	if (Size < SrcLen)
+	{
+		return false;
+	}
+
+	HeaderRaw.Resize(PreHeader.DestSize);
+
+	unsigned long long DestLen = PreHeader.DestSize;
+
+	if (!Decompress(Codec, Ptr, &SrcLen, HeaderRaw.Get(), &DestLen))
+	{
+		return false;
+	}
+
+	return ParseHeader(HeaderRaw.Get(), DestLen, HeaderFlags);
+}
+
+bool GeometryStreamReader::ParseHeader(const unsigned char* Ptr, unsigned long long Size, unsigned long long HeaderFlags)
+{
+	const unsigned char* PtrEnd = Ptr + Size;
+
+	if (Size < sizeof(GeometryCount))
+	{
+		return false;
+	}
+	__hidden_GeometryIOProcessor::Memcpy(&GeometryCount, Ptr, sizeof(GeometryCount));
+	Ptr += sizeof(GeometryCount);
+
+	// every geometry takes at least a name terminator and its bounds, which also keeps the count from sizing buffers out of garbage
+	if (GeometryCount > (static_cast<unsigned long long>(PtrEnd - Ptr) / (sizeof(wchar_t) + sizeof(__hidden_GeometryIOProcessor::MinMax))))
+	{
+		return false;
+	}
+
+	HeaderNames.Resize(GeometryCount);
+	{
+		unsigned long long NameLength = static_cast<unsigned long long>(-1);
+		if ((HeaderFlags & 0x1000000000000000) != 0u)
+		{
+			if (static_cast<unsigned long long>(PtrEnd - Ptr) < sizeof(NameLength))
+			{
+				return false;
+			}
+			__hidden_GeometryIOProcessor::Memcpy(&NameLength, Ptr, sizeof(NameLength));
+			Ptr += sizeof(NameLength);
+		}
+		
+		const unsigned long long MaxNameLength = static_cast<unsigned long long>(PtrEnd - Ptr) / sizeof(wchar_t);
+		if (NameLength > MaxNameLength)
+		{
+			NameLength = MaxNameLength;
+		}
+		
+		const wchar_t* Names = __hidden_GeometryIOProcessor::InPlaceOrCopy(Ptr, NameLength, &HeaderRawNames);
+		const wchar_t* NamesEnd = __hidden_GeometryIOProcessor::ScanNames(Names, Names + NameLength, GeometryCount, HeaderNames.Get());
+		if (!NamesEnd)
+		{
+			return false;
+		}
+		Ptr += (NamesEnd - Names) * sizeof(wchar_t);
+	}
+
+	if (static_cast<unsigned long long>(PtrEnd - Ptr) < (GeometryCount * sizeof(__hidden_GeometryIOProcessor::MinMax)))
 	{
 		return false;
 	}
+	MinMaxView = reinterpret_cast<const __hidden_GeometryIOProcessor::MinMax*>(Ptr);
+	Ptr += GeometryCount * sizeof(__hidden_GeometryIOProcessor::MinMax);
+
+	if ((HeaderFlags & 0x4000000000000000) != 0u)
+	{
+		if (static_cast<unsigned long long>(PtrEnd - Ptr) < (GeometryCount * sizeof(__hidden_GeometryIOProcessor::Location)))
+		{
+			return false;
+		}
+		LocationView = reinterpret_cast<const __hidden_GeometryIOProcessor::Location*>(Ptr);
+		Ptr += GeometryCount * sizeof(__hidden_GeometryIOProcessor::Location);
+	}
+
+	if ((HeaderFlags & 0x2000000000000000) != 0u)
+	{
+		unsigned long BucketCount;
+		if (static_cast<unsigned long long>(PtrEnd - Ptr) < sizeof(BucketCount))
+		{
+			return false;
+		}
+		__hidden_GeometryIOProcessor::Memcpy(&BucketCount, Ptr, sizeof(BucketCount));
+		Ptr += sizeof(BucketCount);
+
+		if (static_cast<unsigned long long>(PtrEnd - Ptr) < (BucketCount * sizeof(unsigned long)))
+		{
+			return false;
+		}
+		NameTableView = __hidden_GeometryIOProcessor::InPlaceOrCopy(Ptr, BucketCount, &HeaderNameTable);
+		NameTableSize = BucketCount;
+
+		// a damaged table is dropped and rebuilt from the names
+		if (!__hidden_GeometryIOProcessor::CheckNameTable(NameTableView, NameTableSize, GeometryCount))
+		{
+			NameTableView = nullptr;
+			NameTableSize = 0u;
+		}
+	}
 
 	return true;
 }
 
+void GeometryStreamReader::BuildNameTable()
+{
+	const wchar_t* const* Names = HeaderNames.Get();
+	__hidden_GeometryIOProcessor::BuildNameTable(GeometryCount, [Names](unsigned long long i)
+	{
+		return Names[i];
+	}, &HeaderNameTable);
+
+	NameTableView = HeaderNameTable.Get();
+	NameTableSize = HeaderNameTable.Size();
+}
+
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -1195,62 +4366,56 @@ bool GeometryStreamWriter::EndWrite()
 	}
 
 	{
-		__hidden_GeometryIOProcessor::ISzAllocForGeometry allocator;
-		{
-			allocator.Alloc = __hidden_GeometryIOProcessor::LZMAAlloc;
-			allocator.Free = __hidden_GeometryIOProcessor::LZMAFree;
-			allocator._this = this;
-		}
-
 #ifdef USE_LZMA2
 		static const unsigned long PropSize = 1u;
 #else
 		static const unsigned long PropSize = LZMA_PROPS_SIZE;
 #endif
 
-		SizeT SrcSize = sizeof(GeometryCount) + (HeaderNames.Size() * sizeof(wchar_t)) + (HeaderMinMaxes.Size() * sizeof(__hidden_GeometryIOProcessor::MinMax));
-		SizeT DestSize = SrcSize + (SrcSize / 3 + 128u);
-		Temporal.Resize(SrcSize + 8u + PropSize + DestSize);
 		{
-			unsigned char* Ptr = Temporal.Get();
-			
-			__hidden_GeometryIOProcessor::MemcpyAndMove(Ptr, &GeometryCount, sizeof(GeometryCount));
-			__hidden_GeometryIOProcessor::MemcpyAndMove(Ptr, HeaderNames.Get(), HeaderNames.Size() * sizeof(wchar_t));
-			__hidden_GeometryIOProcessor::Memcpy(Ptr, HeaderMinMaxes.Get(), HeaderMinMaxes.Size() * sizeof(__hidden_GeometryIOProcessor::MinMax));
+			const wchar_t* NextName = HeaderNames.Get();
+			__hidden_GeometryIOProcessor::BuildNameTable(GeometryCount, [&NextName](unsigned long long)
+			{
+				const wchar_t* Name = NextName;
+				NextName += wcslen(Name) + 1u;
+				return Name;
+			}, &HeaderNameTable);
 		}
-
-#ifdef USE_LZMA2
-		CLzma2EncProps props;
-		Lzma2EncProps_Init(&props);
-		props.lzmaProps.level = 5;
-		props.lzmaProps.lc = 3;
-		props.lzmaProps.lp = 0;
-		props.lzmaProps.pb = 2;
-		props.lzmaProps.fb = 32;
-		props.lzmaProps.numThreads = 8;
-		
-		SRes res = __hidden_GeometryIOProcessor::LZMA2Encode(Temporal.Get() + SrcSize + 8u + PropSize, &DestSize, Temporal.Get() + SrcSize + 8u, Temporal.Get(), SrcSize, &props, nullptr, &allocator, &allocator);
-#else
-		CLzmaEncProps props;
-		LzmaEncProps_Init(&props);
-		props.level = 5;
-		props.lc = 3;
-		props.lp = 0;
-		props.pb = 2;
-		props.fb = 32;
-		props.numThreads = 2;
-
-		SizeT propsSize = PropSize;
 		
-		SRes res = LzmaEncode(Temporal.Get() + SrcSize + 8u + PropSize, &DestSize, Temporal.Get(), SrcSize, &props, Temporal.Get() + SrcSize + 8u, &propsSize, 0, nullptr, &allocator, &allocator);
-#endif
-		if (res != SZ_OK)
+		const unsigned long BucketCount = static_cast<unsigned long>(HeaderNameTable.Size());
+
+		const unsigned long long NameLength = HeaderNames.Size();
+
+		unsigned long long SrcSize = sizeof(GeometryCount) + sizeof(NameLength) + (HeaderNames.Size() * sizeof(wchar_t)) + (HeaderMinMaxes.Size() * sizeof(__hidden_GeometryIOProcessor::MinMax)) + (HeaderLocations.Size() * sizeof(__hidden_GeometryIOProcessor::Location));
+		SrcSize += sizeof(BucketCount) + (HeaderNameTable.Size() * sizeof(unsigned long));
+		const unsigned char Codec = static_cast<unsigned char>(GetEncodeOptions().Codec);
+		const unsigned long long TagSize = (Codec != EncodeOptions::CODEC_LZMA) ? 1u : 0u;
+
+		unsigned long long DestSize = CompressBound(Codec, SrcSize);
+		Temporal.Resize(SrcSize + 8u + TagSize + DestSize);
+		{
+			unsigned char* Ptr = Temporal.Get();
+			
+			__hidden_GeometryIOProcessor::MemcpyAndMove(Ptr, &GeometryCount, sizeof(GeometryCount));
+			__hidden_GeometryIOProcessor::MemcpyAndMove(Ptr, &NameLength, sizeof(NameLength));
+			__hidden_GeometryIOProcessor::MemcpyAndMove(Ptr, HeaderNames.Get(), HeaderNames.Size() * sizeof(wchar_t));
+			__hidden_GeometryIOProcessor::MemcpyAndMove(Ptr, HeaderMinMaxes.Get(), HeaderMinMaxes.Size() * sizeof(__hidden_GeometryIOProcessor::MinMax));
+			__hidden_GeometryIOProcessor::MemcpyAndMove(Ptr, HeaderLocations.Get(), HeaderLocations.Size() * sizeof(__hidden_GeometryIOProcessor::Location));
+			__hidden_GeometryIOProcessor::MemcpyAndMove(Ptr, &BucketCount, sizeof(BucketCount));
+			__hidden_GeometryIOProcessor::Memcpy(Ptr, HeaderNameTable.Get(), HeaderNameTable.Size() * sizeof(unsigned long));
+		}
+
+		// header carries the location table, the name table and the length of the names
+		HeaderPos |= 0x4000000000000000;
+		HeaderPos |= 0x2000000000000000;
+		HeaderPos |= 0x1000000000000000;
+
+		if (!Compress(Codec, Temporal.Get(), SrcSize, Temporal.Get() + SrcSize + 8u + TagSize, &DestSize))
 		{
-			__hidden_GeometryIOProcessor::LZMAGetErrorMsg(res, &ErrorMsg);
 			return false;
 		}
 
-		if (SrcSize > (8u + PropSize + DestSize))
+		if (SrcSize > (8u + TagSize + DestSize))
 		{
 			HeaderPos |= 0x8000000000000000;
 
@@ -1259,11 +4424,17 @@ bool GeometryStreamWriter::EndWrite()
 				unsigned long WriteSize = static_cast<unsigned long>(SrcSize);
 				__hidden_GeometryIOProcessor::Memcpy(Ptr, &WriteSize, 4u);
 				
-				WriteSize = static_cast<unsigned long>(DestSize);
+				// lzma keeps the original layout where the properties aren't counted
+				WriteSize = static_cast<unsigned long>((TagSize > 0u) ? DestSize : (DestSize - PropSize));
 				__hidden_GeometryIOProcessor::Memcpy(Ptr + 4u, &WriteSize, 4u);
 			}
+			if (TagSize > 0u)
+			{
+				HeaderPos |= 0x0800000000000000;
+				Ptr[8] = Codec;
+			}
 
-			if (!CustomWrite(Handle, 8u + PropSize + DestSize, Ptr))
+			if (!CustomWrite(Handle, 8u + TagSize + DestSize, Ptr))
 			{
 				return false;
 			}
@@ -1304,14 +4475,29 @@ bool GeometryStreamWriter::EndWrite()
 
 bool GeometryStreamReader::EndRead()
 {
-	if (!Handle)
+	if (!Handle && !MappedData)
 	{
 		return false;
 	}
+
+	ResetRead();
 	
 	return true;
 }
 
+void GeometryStreamReader::ResetRead()
+{
+	Handle = nullptr;
+	MappedData = nullptr;
+	MappedSize = 0u;
+
+	GeometryCount = 0u;
+	MinMaxView = nullptr;
+	LocationView = nullptr;
+	NameTableView = nullptr;
+	NameTableSize = 0u;
+}
+
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -1327,115 +4513,326 @@ unsigned long long GeometryStreamWriter::EmplaceGeometry(
 	const unsigned long* Inds,
 
 	unsigned long OptionalEncodeOffset,
-	bool OptionalUseFloat32Vertex
+	bool OptionalUseFloat32Vertex,
+	unsigned long* OptionalVertexRemap
 	)
 {
+	__hidden_GeometryIOProcessor::MinMax GeometryMinMax;
+
+	// the bounds only read the caller's data, so big meshes get them on their own thread while encoding once threads are allowed.
+	// their scratch is sized here first, so that thread never calls Alloc
+	std::thread BoundsThread;
+	if (((VertCount / 3u) >= (1u << 16u)) && (GetEncodeOptions().ThreadCount != 1u))
+	{
+		Temporal.Resize(__hidden_GeometryIOProcessor::MinMaxScratchSize(VertCount));
+		BoundsThread = std::thread([&]()
+		{
+			__hidden_GeometryIOProcessor::ComputeMinMax(Scale, Rotation, Position, VertCount, IndCount, Verts, Inds, &Temporal, &GeometryMinMax);
+		});
+	}
+
 	unsigned long long EncodedSize;
 	unsigned char* EncodedData;
-	if (!Encode(Scale, Rotation, Position, VertCount, IndCount, Verts, Inds, &EncodedSize, &EncodedData, OptionalEncodeOffset, OptionalUseFloat32Vertex))
+	const bool bEncoded = Encode(Scale, Rotation, Position, VertCount, IndCount, Verts, Inds, &EncodedSize, &EncodedData, OptionalEncodeOffset, OptionalUseFloat32Vertex, OptionalVertexRemap);
+
+	if (BoundsThread.joinable())
+	{
+		BoundsThread.join();
+	}
+	else if (bEncoded)
+	{
+		__hidden_GeometryIOProcessor::ComputeMinMax(Scale, Rotation, Position, VertCount, IndCount, Verts, Inds, &Temporal, &GeometryMinMax);
+	}
+
+	if (!bEncoded)
 	{
 		return static_cast<unsigned long long>(-1);
 	}
 
+	if (!CommitGeometry(ID, EncodedSize, EncodedData, GeometryMinMax))
 	{
-		if (!CustomWrite(Handle, sizeof(EncodedSize), &EncodedSize))
+		return static_cast<unsigned long long>(-1);
+	}
+	
+	return GeometryCount;
+}
+unsigned long long GeometryStreamWriter::EmplaceGeometries(const GeometryDesc* Descs, unsigned long long Count, unsigned long OptionalThreadCount)
+{
+	struct Job
+	{
+		unsigned char* EncodedData;
+		unsigned long long EncodedSize;
+		__hidden_GeometryIOProcessor::MinMax GeometryMinMax;
+		bool bClaimed;
+		bool bDone;
+	};
+
+	if (!Handle)
+	{
+		return static_cast<unsigned long long>(-1);
+	}
+	if (Count == 0u)
+	{
+		return GeometryCount;
+	}
+
+	unsigned long long ThreadCount = (OptionalThreadCount > 0u) ? OptionalThreadCount : std::thread::hardware_concurrency();
+	ThreadCount = (ThreadCount > 0u) ? ThreadCount : 1u;
+	ThreadCount = (ThreadCount < Count) ? ThreadCount : Count;
+
+	__hidden_GeometryIOProcessor::TempBuffer<Job> Jobs(this);
+	__hidden_GeometryIOProcessor::TempBuffer<unsigned long long> Order(this);
+	{
+		Jobs.Resize(Count);
+		Order.Resize(Count);
+		for (unsigned long long i = 0u; i < Count; ++i)
 		{
-			return static_cast<unsigned long long>(-1);
+			Jobs[i].EncodedData = nullptr;
+			Jobs[i].EncodedSize = 0u;
+			Jobs[i].bClaimed = false;
+			Jobs[i].bDone = false;
+
+			Order[i] = i;
 		}
 
-		if (!CustomWrite(Handle, EncodedSize, EncodedData))
+		// largest meshes are encoded first, so that no worker is left alone with a big one at the end
+		std::stable_sort(Order.Get(), Order.Get() + Count, [Descs](unsigned long long A, unsigned long long B)
 		{
-			return static_cast<unsigned long long>(-1);
-		}
+			const unsigned long long WeightA = static_cast<unsigned long long>(Descs[A].VertCount) + Descs[A].IndCount;
+			const unsigned long long WeightB = static_cast<unsigned long long>(Descs[B].VertCount) + Descs[B].IndCount;
+			return WeightA > WeightB;
+		});
 	}
-	
-	__hidden_GeometryIOProcessor::MinMax GeometryMinMax;
+
+	std::mutex JobLock;
+	std::condition_variable JobDone;
+	unsigned long long NextJob = 0u;
+	unsigned long long NextPending = 0u;
+	unsigned long long HeldCount = 0u;
+	bool bAbort = false;
+
+	// payloads finished ahead of their turn are held in memory, so only this many may wait before the writer catches up
+	const unsigned long long MaxHeld = ThreadCount << 1u;
+
+	// largest first, but once MaxHeld payloads are held the lowest unclaimed index goes next, which is what the writer waits for.
+	// called under JobLock, returns Count when nothing is left
+	auto ClaimJob = [&]() -> unsigned long long
 	{
-		Temporal.Resize(VertCount << 3u);
+		if (HeldCount >= MaxHeld)
+		{
+			while ((NextPending < Count) && Jobs[NextPending].bClaimed)
+			{
+				++NextPending;
+			}
+			if (NextPending < Count)
+			{
+				Jobs[NextPending].bClaimed = true;
+				return NextPending;
+			}
+			return Count;
+		}
 
-		double GeometryMin[] = { DBL_MAX, DBL_MAX, DBL_MAX };
-		double GeometryMax[] = { -DBL_MAX, -DBL_MAX, -DBL_MAX };
+		while ((NextJob < Count) && Jobs[Order[NextJob]].bClaimed)
+		{
+			++NextJob;
+		}
+		if (NextJob < Count)
+		{
+			Jobs[Order[NextJob]].bClaimed = true;
+			return Order[NextJob];
+		}
+		return Count;
+	};
+
+	auto Worker = [&]()
+	{
+		GeometryWriter Writer(CustomAlloc, CustomFree);
+		Writer.SetEncodeOptions(GetEncodeOptions());
+		__hidden_GeometryIOProcessor::TempBuffer<unsigned char> Scratch(&Writer);
+
+		for (;;)
 		{
-			const double* Src = Verts;
-			double* Dest = reinterpret_cast<double*>(Temporal.Get());
-			for (const double* SrcEnd = Src + VertCount; Src != SrcEnd; Src += 3u, Dest += 3u)
+			unsigned long long Index;
 			{
+				std::lock_guard<std::mutex> Lock(JobLock);
+				if (bAbort)
 				{
-					Dest[0] = Src[0] * Scale[0];
-					Dest[1] = Src[1] * Scale[1];
-					Dest[2] = Src[2] * Scale[2];
+					break;
 				}
+				Index = ClaimJob();
+			}
+			if (Index >= Count)
+			{
+				break;
+			}
 
-				{ // http://people.csail.mit.edu/bkph/articles/Quaternions.pdf
-					double TTX = 2. * (Rotation[1] * Dest[2] - Rotation[2] * Dest[1]);
-					double TTY = 2. * (Rotation[2] * Dest[0] - Rotation[0] * Dest[2]);
-					double TTZ = 2. * (Rotation[0] * Dest[1] - Rotation[1] * Dest[0]);
+			const GeometryDesc& Desc = Descs[Index];
 
-					const double TT2X = 2. * (Rotation[1] * TTZ - Rotation[2] * TTY);
-					const double TT2Y = 2. * (Rotation[2] * TTX - Rotation[0] * TTZ);
-					const double TT2Z = 2. * (Rotation[0] * TTY - Rotation[1] * TTX);
+			unsigned long long EncodedSize;
+			unsigned char* EncodedData;
+			unsigned char* HeldData = nullptr;
+			__hidden_GeometryIOProcessor::MinMax GeometryMinMax;
+			const bool bSucceeded = Writer.Encode(Desc.Scale, Desc.Rotation, Desc.Position, Desc.VertCount, Desc.IndCount, Desc.Verts, Desc.Inds, &EncodedSize, &EncodedData, Desc.OptionalEncodeOffset, Desc.OptionalUseFloat32Vertex, Desc.OptionalVertexRemap);
+			if (bSucceeded)
+			{
+				// the writer reuses its buffer for the next geometry, so keep a copy until it's written
+				HeldData = reinterpret_cast<unsigned char*>(CustomAlloc(EncodedSize));
+				if (HeldData)
+				{
+					__hidden_GeometryIOProcessor::Memcpy(HeldData, EncodedData, EncodedSize);
+					__hidden_GeometryIOProcessor::ComputeMinMax(Desc.Scale, Desc.Rotation, Desc.Position, Desc.VertCount, Desc.IndCount, Desc.Verts, Desc.Inds, &Scratch, &GeometryMinMax);
+				}
+			}
 
-					TTX *= Rotation[3];
-					TTY *= Rotation[3];
-					TTZ *= Rotation[3];
+			{
+				std::lock_guard<std::mutex> Lock(JobLock);
+
+				if (!HeldData && !bAbort)
+				{
+					if (bSucceeded)
+					{
+						__hidden_GeometryIOProcessor::SetErrorMsg(__hidden_GeometryIOProcessor::ERRPrefixGeometry, "out of memory", &ErrorMsg);
+					}
+					else
+					{
+						const char* Msg = Writer.GetLastError();
+						const unsigned long long LenMsg = strlen(Msg) + 1u;
+						ErrorMsg.Resize(LenMsg);
+						__hidden_GeometryIOProcessor::Memcpy(ErrorMsg.Get(), Msg, LenMsg);
+					}
 
-					Dest[0] += TTX + TT2X;
-					Dest[1] += TTY + TT2Y;
-					Dest[2] += TTZ + TT2Z;
+					bAbort = true;
 				}
 
+				// the job is only published here, complete, so the writer never sees it half done
+				Job& CurJob = Jobs[Index];
+				if (HeldData)
 				{
-					Dest[0] += Position[0];
-					Dest[1] += Position[1];
-					Dest[2] += Position[2];
+					CurJob.EncodedData = HeldData;
+					CurJob.EncodedSize = EncodedSize;
+					CurJob.GeometryMinMax = GeometryMinMax;
+					++HeldCount;
 				}
+				CurJob.bDone = true;
 			}
+			JobDone.notify_all();
 		}
+	};
 
+	std::unique_ptr<std::thread[]> Threads(new std::thread[ThreadCount]);
+	for (unsigned long long i = 0u; i < ThreadCount; ++i)
+	{
+		Threads[i] = std::thread(Worker);
+	}
+
+	// payloads go out in submission order no matter which worker finishes first
+	bool bSucceeded = true;
+	for (unsigned long long i = 0u; i < Count; ++i)
+	{
+		Job& CurJob = Jobs[i];
+		bool bDone;
 		{
-			const unsigned long* Src = Inds;
-			for (const unsigned long* SrcEnd = Src + IndCount; Src != SrcEnd; ++Src)
-			{
-				double X, Y, Z;
-				{
-					const double* Ptr = &(reinterpret_cast<const double*>(Temporal.Get())[(*Src) * 3u]);
+			std::unique_lock<std::mutex> Lock(JobLock);
+			JobDone.wait(Lock, [&CurJob, &bAbort]() { return CurJob.bDone || bAbort; });
+			bDone = CurJob.bDone;
+		}
 
-					X = *Ptr;
-					Y = *(Ptr + 1u);
-					Z = *(Ptr + 2u);
-				}
+		// an abort may wake us while this job is still being worked on, so it's left alone then
+		if (!bDone || !CurJob.EncodedData)
+		{
+			bSucceeded = false;
+			break;
+		}
 
-				GeometryMin[0] = (GeometryMin[0] > X) ? X : GeometryMin[0];
-				GeometryMin[1] = (GeometryMin[1] > Y) ? Y : GeometryMin[1];
-				GeometryMin[2] = (GeometryMin[2] > Z) ? Z : GeometryMin[2];
+		const bool bCommitted = CommitGeometry(Descs[i].ID, CurJob.EncodedSize, CurJob.EncodedData, CurJob.GeometryMinMax);
 
-				GeometryMax[0] = (GeometryMax[0] < X) ? X : GeometryMax[0];
-				GeometryMax[1] = (GeometryMax[1] < Y) ? Y : GeometryMax[1];
-				GeometryMax[2] = (GeometryMax[2] < Z) ? Z : GeometryMax[2];
-			}
+		CustomFree(CurJob.EncodedData);
+		CurJob.EncodedData = nullptr;
+		{
+			std::lock_guard<std::mutex> Lock(JobLock);
+			--HeldCount;
 		}
 
-		__hidden_GeometryIOProcessor::Memcpy(GeometryMinMax.Min, GeometryMin, sizeof(GeometryMin));
-		__hidden_GeometryIOProcessor::Memcpy(GeometryMinMax.Max, GeometryMax, sizeof(GeometryMax));
+		if (!bCommitted)
+		{
+			bSucceeded = false;
+			break;
+		}
 	}
-	
+
+	if (!bSucceeded)
 	{
-		const unsigned long long IDLen = wcslen(ID);
-		const unsigned long long OldSize = HeaderNames.Size();
-		
-		HeaderNames.Resize(OldSize + IDLen + 1u);
+		std::lock_guard<std::mutex> Lock(JobLock);
+		bAbort = true;
+	}
+	for (unsigned long long i = 0u; i < ThreadCount; ++i)
+	{
+		Threads[i].join();
+	}
 
-		__hidden_GeometryIOProcessor::Memcpy(HeaderNames.Get() + OldSize, ID, IDLen * sizeof(wchar_t));
-		*(HeaderNames.Get() + HeaderNames.Size() - 1u) = 0u;
+	for (unsigned long long i = 0u; i < Count; ++i)
+	{
+		if (Jobs[i].EncodedData)
+		{
+			CustomFree(Jobs[i].EncodedData);
+		}
 	}
+
+	return bSucceeded ? GeometryCount : static_cast<unsigned long long>(-1);
+}
+bool GeometryStreamWriter::CommitGeometry(const wchar_t* ID, unsigned long long EncodedSize, const unsigned char* EncodedData, const __hidden_GeometryIOProcessor::MinMax& GeometryMinMax)
+{
+	__hidden_GeometryIOProcessor::Location GeometryLocation;
 	{
-		const unsigned long long OldSize = HeaderMinMaxes.Size();
-		
-		HeaderMinMaxes.Resize(OldSize + 1u);
-		__hidden_GeometryIOProcessor::Memcpy(HeaderMinMaxes.Get() + OldSize, &GeometryMinMax, sizeof(GeometryMinMax));
+		if (!CustomWrite(Handle, sizeof(EncodedSize), &EncodedSize))
+		{
+			return false;
+		}
+
+		if (!CustomTell(Handle, &GeometryLocation.Position))
+		{
+			return false;
+		}
+		GeometryLocation.Size = EncodedSize;
+
+		if (!CustomWrite(Handle, EncodedSize, EncodedData))
+		{
+			return false;
+		}
 	}
 	
-	return ++GeometryCount;
+	HeaderNames.Append(ID, wcslen(ID) + 1u);
+	HeaderMinMaxes.Append(&GeometryMinMax, 1u);
+	HeaderLocations.Append(&GeometryLocation, 1u);
+	
+	++GeometryCount;
+	return true;
+}
+
+unsigned long GeometryStreamReader::FindGeometry(const wchar_t* ID) const
+{
+	const unsigned long long BucketCount = NameTableSize;
+	if (BucketCount == 0u)
+	{
+		return static_cast<unsigned long>(-1);
+	}
+
+	const unsigned long long Mask = BucketCount - 1u;
+	unsigned long long Bucket = __hidden_GeometryIOProcessor::HashName(ID) & Mask;
+	for (unsigned long long Step = 0u; Step < BucketCount; ++Step, Bucket = (Bucket + 1u) & Mask)
+	{
+		const unsigned long Index = NameTableView[Bucket];
+		if (Index == static_cast<unsigned long>(-1))
+		{
+			break;
+		}
+		if (wcscmp(HeaderNames[Index], ID) == 0)
+		{
+			return Index;
+		}
+	}
+
+	return static_cast<unsigned long>(-1);
 }
 
 bool GeometryStreamReader::GetGeometry(
@@ -1449,40 +4846,107 @@ bool GeometryStreamReader::GetGeometry(
 	unsigned long** Inds
 	)
 {
-	if (!CustomJump(Handle, FileBegin))
+	return DecodeGeometry(Index, Scale, Rotation, Position, VertCount, IndCount, Verts, Inds, nullptr, nullptr, GetDecodeOptions().VertexSpace, false);
+}
+bool GeometryStreamReader::GetGeometry(
+	unsigned long Index,
+	double* Scale,
+	double* Rotation,
+	double* Position,
+	unsigned long* VertCount,
+	unsigned long* IndCount,
+	double* Verts,
+	unsigned long VertCapacity,
+	unsigned long* Inds,
+	unsigned long IndCapacity
+	)
+{
+	struct DestSpans
 	{
-		return false;
+		double* Verts;
+		unsigned long VertCapacity;
+		unsigned long* Inds;
+		unsigned long IndCapacity;
+		__hidden_GeometryIOProcessor::TempBuffer<char>* ErrorMsg;
 	}
-	
-	for (unsigned long i = 0u; i < Index; ++i)
+	Dest = { Verts, VertCapacity, Inds, IndCapacity, &ErrorMsg };
+
+	double* OutVerts;
+	unsigned long* OutInds;
+	return DecodeGeometry(Index, Scale, Rotation, Position, VertCount, IndCount, &OutVerts, &OutInds, [](void* Context, unsigned long VertCount, unsigned long IndCount, double** Verts, unsigned long** Inds) -> bool
 	{
-		unsigned long long EncodedSize = 0u;
-		if (!CustomRead(Handle, sizeof(EncodedSize), &EncodedSize))
+		DestSpans* Dest = static_cast<DestSpans*>(Context);
+		if ((VertCount > Dest->VertCapacity) || (IndCount > Dest->IndCapacity))
 		{
+			__hidden_GeometryIOProcessor::SetErrorMsg(__hidden_GeometryIOProcessor::ERRPrefixGeometry, "destination buffer too small", Dest->ErrorMsg);
 			return false;
 		}
-		if (!CustomJump(Handle, EncodedSize))
+
+		(*Verts) = Dest->Verts;
+		(*Inds) = Dest->Inds;
+		return true;
+	}, &Dest, GetDecodeOptions().VertexSpace, false);
+}
+
+bool GeometryStreamReader::DecodeGeometry(
+	unsigned long Index,
+	double* Scale,
+	double* Rotation,
+	double* Position,
+	unsigned long* VertCount,
+	unsigned long* IndCount,
+	double** Verts,
+	unsigned long** Inds,
+	DestAlloc Alloc,
+	void* Context,
+	DecodeOptions::VertexSpaceType Space,
+	bool bFloatVerts
+	)
+{
+	if (Index >= GeometryCount)
+	{
+		return false;
+	}
+	
+	const unsigned char* EncodedData;
+	if (!ReadPayload(Index, &Temporal, &EncodedData))
+	{
+		return false;
+	}
+
+	if (!Decode(LocationView[Index].Size, EncodedData, Scale, Rotation, Position, VertCount, IndCount, Verts, Inds, Alloc, Context, Space, bFloatVerts))
+	{
+		return false;
+	}
+
+	return true;
+}
+bool GeometryStreamReader::ReadPayload(unsigned long Index, __hidden_GeometryIOProcessor::TempBuffer<unsigned char>* Buffer, const unsigned char** EncodedData)
+{
+	const __hidden_GeometryIOProcessor::Location& GeometryLocation = LocationView[Index];
+	if (MappedData)
+	{
+		if ((GeometryLocation.Position > MappedSize) || (GeometryLocation.Size > (MappedSize - GeometryLocation.Position)))
 		{
 			return false;
 		}
+
+		(*EncodedData) = MappedData + GeometryLocation.Position;
 	}
+	else
 	{
-		unsigned long long EncodedSize = 0u;
-		if (!CustomRead(Handle, sizeof(EncodedSize), &EncodedSize))
+		if (!CustomJump(Handle, GeometryLocation.Position))
 		{
 			return false;
 		}
 
-		Temporal.Resize(EncodedSize);
-		if (!CustomRead(Handle, EncodedSize, Temporal.Get()))
+		Buffer->Resize(GeometryLocation.Size);
+		if (!CustomRead(Handle, GeometryLocation.Size, Buffer->Get()))
 		{
 			return false;
 		}
-	}
 
-	if (!Decode(Temporal.Size(), Temporal.Get(), Scale, Rotation, Position, VertCount, IndCount, Verts, Inds))
-	{
-		return false;
+		(*EncodedData) = Buffer->Get();
 	}
 
 	return true;
@@ -1497,29 +4961,8 @@ bool GeometryStreamReader::GetGeometry(
 	unsigned long** Inds
 	)
 {
-	double Scale[3] = { 1., 1., 1. };
-	if (!GetGeometry(
-		Index,
-		Scale,
-		Rotation,
-		Position,
-		VertCount,
-		IndCount,
-		Verts,
-		Inds
-		))
-	{
-		return false;
-	}
-
-	for (double *Ptr = (*Verts), *PtrEnd = (*Verts) + (*VertCount); Ptr != PtrEnd; Ptr += 3)
-	{
-		(*Ptr) *= Scale[0];
-		(*(Ptr + 1)) *= Scale[1];
-		(*(Ptr + 2)) *= Scale[2];
-	}
-
-	return true;
+	double Scale[3];
+	return DecodeGeometry(Index, Scale, Rotation, Position, VertCount, IndCount, Verts, Inds, nullptr, nullptr, __hidden_GeometryIOProcessor::ScaledVertexSpace(GetDecodeOptions().VertexSpace), false);
 }
 bool GeometryStreamReader::GetGeometry(
 	unsigned long Index,
@@ -1532,29 +4975,14 @@ bool GeometryStreamReader::GetGeometry(
 	unsigned long** Inds
 )
 {
-	double** RawVerts = nullptr;
-	if (!GetGeometry(
-	Index,
-	Scale,
-	Rotation,
-	Position,
-	VertCount,
-	IndCount,
-	RawVerts,
-	Inds
-	))
+	// the decoder writes floats straight into the buffer, so the pointer only changes type
+	double* RawVerts;
+	if (!DecodeGeometry(Index, Scale, Rotation, Position, VertCount, IndCount, &RawVerts, Inds, nullptr, nullptr, GetDecodeOptions().VertexSpace, true))
 	{
 		return false;
 	}
 
-	const double* Verts64 = (*RawVerts);
-	float* Verts32 = reinterpret_cast<float*>(*RawVerts);
-	for (const double* Verts64End = Verts64 + (*VertCount); Verts64 != Verts64End; ++Verts64, ++Verts32)
-	{
-		(*Verts32) = static_cast<float>(*Verts64);
-	}
-
-	(*Verts) = Verts32;
+	(*Verts) = reinterpret_cast<float*>(RawVerts);
 	return true;
 }
 bool GeometryStreamReader::GetGeometry(
@@ -1567,35 +4995,131 @@ bool GeometryStreamReader::GetGeometry(
 	unsigned long** Inds
 )
 {
-	double Scale[3] = { 1., 1., 1. };
-	double** RawVerts = nullptr;
-	if (!GetGeometry(
-	Index,
-	Scale,
-	Rotation,
-	Position,
-	VertCount,
-	IndCount,
-	RawVerts,
-	Inds
-	))
+	double Scale[3];
+	double* RawVerts;
+	if (!DecodeGeometry(Index, Scale, Rotation, Position, VertCount, IndCount, &RawVerts, Inds, nullptr, nullptr, __hidden_GeometryIOProcessor::ScaledVertexSpace(GetDecodeOptions().VertexSpace), true))
+	{
+		return false;
+	}
+
+	(*Verts) = reinterpret_cast<float*>(RawVerts);
+	return true;
+}
+
+bool GeometryStreamReader::GetGeometries(const unsigned long* Indices, unsigned long long Count, GeometryCallback Callback, void* Context, unsigned long OptionalThreadCount)
+{
+	if (!Handle && !MappedData)
 	{
 		return false;
 	}
+	for (unsigned long long i = 0u; i < Count; ++i)
+	{
+		if (Indices[i] >= GeometryCount)
+		{
+			return false;
+		}
+	}
+	if (Count == 0u)
+	{
+		return true;
+	}
+
+	unsigned long long ThreadCount = (OptionalThreadCount > 0u) ? OptionalThreadCount : std::thread::hardware_concurrency();
+	ThreadCount = (ThreadCount > 0u) ? ThreadCount : 1u;
+	ThreadCount = (ThreadCount < Count) ? ThreadCount : Count;
 
-	const double* Verts64 = (*RawVerts);
-	float* Verts32 = reinterpret_cast<float*>(*RawVerts);
-	for (const double* Verts64End = Verts64 + (*VertCount); Verts64 != Verts64End; Verts64 += 3u, Verts32 += 3u)
+	__hidden_GeometryIOProcessor::TempBuffer<unsigned long> Order(this);
 	{
-		(*Verts32) = static_cast<float>((*Verts64) * Scale[0]);
-		(*(Verts32 + 1u)) = static_cast<float>((*(Verts64 + 1u)) * Scale[1]);
-		(*(Verts32 + 2u)) = static_cast<float>((*(Verts64 + 2u)) * Scale[2]);
+		Order.Resize(Count);
+		__hidden_GeometryIOProcessor::Memcpy(Order.Get(), Indices, Count * sizeof(unsigned long));
+
+		// largest payloads are decoded first, so that no worker is left alone with a big one at the end
+		std::stable_sort(Order.Get(), Order.Get() + Count, [this](unsigned long A, unsigned long B)
+		{
+			return LocationView[A].Size > LocationView[B].Size;
+		});
 	}
 
-	(*Verts) = Verts32;
-	return true;
-}
+	std::mutex ReadLock;
+	std::mutex ErrorLock;
+	std::atomic<unsigned long long> NextJob(0u);
+	std::atomic<bool> bAbort(false);
+
+	auto Worker = [&]()
+	{
+		GeometryReader Reader(CustomAlloc, CustomFree);
+		Reader.SetDecodeOptions(GetDecodeOptions());
+		Reader.SetDecodeThreadCount(1u);
+		__hidden_GeometryIOProcessor::TempBuffer<unsigned char> Payload(&Reader);
+
+		for (;;)
+		{
+			const unsigned long long Slot = NextJob++;
+			if ((Slot >= Count) || bAbort)
+			{
+				break;
+			}
+
+			const unsigned long Index = Order[Slot];
+
+			const unsigned char* EncodedData;
+			{
+				// the file handle is shared, so only the mapped archive is read without the lock
+				std::unique_lock<std::mutex> Lock(ReadLock, std::defer_lock);
+				if (!MappedData)
+				{
+					Lock.lock();
+				}
+
+				if (!ReadPayload(Index, &Payload, &EncodedData))
+				{
+					bAbort = true;
+					break;
+				}
+			}
+
+			double Scale[3];
+			double Rotation[4];
+			double Position[3];
+			unsigned long VertCount;
+			unsigned long IndCount;
+			double* Verts;
+			unsigned long* Inds;
+			if (!Reader.Decode(LocationView[Index].Size, EncodedData, Scale, Rotation, Position, &VertCount, &IndCount, &Verts, &Inds))
+			{
+				std::lock_guard<std::mutex> Lock(ErrorLock);
+				if (!bAbort)
+				{
+					const char* Msg = Reader.GetLastError();
+					const unsigned long long LenMsg = strlen(Msg) + 1u;
+					ErrorMsg.Resize(LenMsg);
+					__hidden_GeometryIOProcessor::Memcpy(ErrorMsg.Get(), Msg, LenMsg);
 
+					bAbort = true;
+				}
+				break;
+			}
+
+			if (!Callback(Context, Index, Scale, Rotation, Position, VertCount, IndCount, Verts, Inds))
+			{
+				bAbort = true;
+				break;
+			}
+		}
+	};
+
+	std::unique_ptr<std::thread[]> Threads(new std::thread[ThreadCount]);
+	for (unsigned long long i = 0u; i < ThreadCount; ++i)
+	{
+		Threads[i] = std::thread(Worker);
+	}
+	for (unsigned long long i = 0u; i < ThreadCount; ++i)
+	{
+		Threads[i].join();
+	}
+
+	return !bAbort;
+}
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
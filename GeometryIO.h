@@ -3,6 +3,7 @@
 
 
 #include <memory>
+#include <type_traits>
 
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -224,6 +225,32 @@ namespace __hidden_GeometryIOProcessor
 				(*Ptr) = Init;
 			}
 		}
+		void Reserve(SizeType NewSize)
+		{
+			if (AssignedSize < NewSize)
+			{
+				BufferType* OldBuffer = Buffer;
+				Buffer = reinterpret_cast<BufferType*>(CurIO->CustomAlloc(NewSize * sizeof(BufferType)));
+				if (OldBuffer)
+				{
+					Memcpy(Buffer, OldBuffer, VisibleSize * sizeof(BufferType));
+					CurIO->CustomFree(OldBuffer);
+				}
+				AssignedSize = NewSize;
+			}
+		}
+		void Append(const BufferType* Src, SizeType Count)
+		{
+			const SizeType NewSize = VisibleSize + Count;
+			if (AssignedSize < NewSize)
+			{
+				// grow geometrically, so that appending one by one stays linear
+				const SizeType DoubledSize = AssignedSize << 1u;
+				Reserve((DoubledSize > NewSize) ? DoubledSize : NewSize);
+			}
+			Memcpy(Buffer + VisibleSize, Src, Count * sizeof(BufferType));
+			VisibleSize = NewSize;
+		}
 
 		inline BufferType* Get()
 		{
@@ -257,7 +284,22 @@ namespace __hidden_GeometryIOProcessor
 		};
 		double Raw[6];
 	};
+
+	struct Location
+	{
+		unsigned long long Position;
+		unsigned long long Size;
+	};
 #pragma pack(pop)
+
+	// what the reader applies to vertices as they are decoded. without bRotate only Scale is
+	struct VertexTransform
+	{
+		double Scale[3];
+		double Rotation[4];
+		double Translation[3];
+		bool bRotate;
+	};
 };
 
 
@@ -266,13 +308,92 @@ namespace __hidden_GeometryIOProcessor
 
 class GeometryWriter : public __hidden_GeometryIOProcessor::CustomIO
 {
+public:
+	struct EncodeOptions
+	{
+		enum MatchFinderMode
+		{
+			MATCHFINDER_HC4,
+			MATCHFINDER_HC5,
+			MATCHFINDER_BT2,
+			MATCHFINDER_BT3,
+			MATCHFINDER_BT4,
+		};
+		enum VertexLayoutType
+		{
+			VERTEX_INTERLEAVED,
+			VERTEX_PLANAR,
+		};
+		enum IndexFormatType
+		{
+			INDEX_BITPACKED,
+			INDEX_CONNECTIVITY,
+		};
+		// stored with each payload, so readers handle archives that mix codecs
+		enum CodecType
+		{
+			CODEC_LZMA,
+			CODEC_LZ,
+		};
+
+		// planar codes x, y and z as separate fields so that fpzip predicts each axis from itself. interleaved is the layout of older archives
+		VertexLayoutType VertexLayout = VERTEX_PLANAR;
+		// above 0, vertices are snapped to a grid that keeps every coordinate within this absolute error. the error reached is stored with the payload
+		double MaxVertexError = 0.;
+		// vertices per independently coded fpzip chunk. chunks are coded on ThreadCount threads and decoded on the reader's decode threads. 0 picks 256K, -1 never splits
+		unsigned long VertexChunkSize = 0u;
+		// connectivity codes triangles through edges shared with recent ones. it falls back to bit packing whenever that is smaller
+		IndexFormatType IndexFormat = INDEX_BITPACKED;
+		// merges each vertex into an earlier one whose coordinates all lie within WeldTolerance. 0 merges equal positions only
+		bool WeldVertices = false;
+		double WeldTolerance = 0.;
+		// reorders triangles for the post-transform vertex cache and renumbers vertices in first use order. the triangle set itself is unchanged
+		bool ReorderForVertexCache = false;
+		
+		// lzma for size, lz for load speed. the settings below only apply to lzma
+		CodecType Codec = CODEC_LZMA;
+
+		// 0 ~ 9
+		int Level = 5;
+		// 0 sizes the dictionary from each payload, up to the default of Level
+		unsigned long DictSize = 0u;
+		// hash chain modes also switch the encoder to fast parsing
+		MatchFinderMode MatchFinder = MATCHFINDER_BT4;
+		// lzma and fpzip chunk threads. 0 means one per core. payloads smaller than 256KB are always encoded on one thread. Alloc and Free must be thread-safe unless this is 1
+		unsigned long ThreadCount = 1u;
+		// LiteralContextBits + LiteralPositionBits must not exceed 4. lp 2 / pb 2 suits 4 byte aligned data, lc 1 / lp 3 / pb 3 suits 8 byte aligned data
+		int LiteralContextBits = 3;
+		int LiteralPositionBits = 0;
+		int PositionBits = 2;
+		int FastBytes = 32;
+		// payloads larger than this are split into independent lzma2 blocks which readers decode in parallel. 0 picks four dictionaries (1MB ~ 256MB), -1 never splits
+		unsigned long long BlockSize = 0u;
+
+		// Fastest encodes on every core, so it needs thread-safe Alloc and Free as well
+		static EncodeOptions Fastest();
+		static EncodeOptions Balanced();
+		static EncodeOptions Smallest();
+		static EncodeOptions FastLoad();
+	};
+
+	
 public:
 	GeometryWriter(MemAlloc Alloc, MemFree Free)
 		: __hidden_GeometryIOProcessor::CustomIO(Alloc, Free)
 		, TempSrcForEncoding(this)
 		, TempDestForEncoding(this)
+		, TempTableForEncoding(this)
+		, TempVertsForWeld(this)
+		, TempIndsForWeld(this)
+		, TempVertsForReorder(this)
+		, TempIndsForReorder(this)
 		, ErrorMsg(this)
+		, LZMAEncoder(nullptr)
 	{}
+	~GeometryWriter()
+	{
+		ReleaseEncoder();
+	}
 
 
 public:
@@ -282,6 +403,14 @@ public:
 		return ErrorMsg.Get() ? ErrorMsg.Get() : NullStr;
 	}
 
+public:
+	// applies to every payload encoded afterwards
+	void SetEncodeOptions(const EncodeOptions& NewOptions);
+	const EncodeOptions& GetEncodeOptions() const
+	{
+		return Options;
+	}
+
 	
 public:
 	bool Encode(
@@ -296,27 +425,71 @@ public:
 		unsigned char** EncodedData,
 
 		unsigned long OptionalEncodeOffset = ENCODE_OFFSET,
-		bool OptionalUseFloat32Vertex = false
+		bool OptionalUseFloat32Vertex = false,
+		// receives the new index of every original vertex (VertCount / 3 entries)
+		unsigned long* OptionalVertexRemap = nullptr
 		);
 
+protected:
+	// room Compress needs in Dest for SrcLen bytes
+	static unsigned long long CompressBound(unsigned char Codec, unsigned long long SrcLen);
+	// compresses SrcLen bytes into Dest, which holds DestLen bytes on entry and the compressed size on return. coder properties are part of the output
+	bool Compress(unsigned char Codec, const unsigned char* Src, unsigned long long SrcLen, unsigned char* Dest, unsigned long long* DestLen);
+
+private:
+	bool CompressLZMA(const unsigned char* Src, unsigned long long SrcLen, unsigned char* Prop, unsigned char* Dest, unsigned long long* DestLen);
+	bool CompressLZ(const unsigned char* Src, unsigned long long SrcLen, unsigned char* Dest, unsigned long long* DestLen);
+	void ReleaseEncoder();
+
 	
 private:
-	bool Pack(bool bUseFloat32);
+	// both leave the result in their own buffers and map the RemapCount entries of VertexRemap through the new vertex order
+	bool WeldVertices(unsigned long VertCount, unsigned long IndCount, const double* Verts, const unsigned long* Inds, unsigned long* VertexRemap, unsigned long RemapCount);
+	bool ReorderForVertexCache(unsigned long VertCount, unsigned long IndCount, const double* Verts, const unsigned long* Inds, unsigned long* VertexRemap, unsigned long RemapCount);
+
+private:
+	bool Pack(
+		const double* Scale,
+		const double* Rotation,
+		const double* Position,
+		unsigned long VertCount,
+		unsigned long IndCount,
+		const double* Verts,
+		const unsigned long* Inds,
+		bool bUseFloat32
+		);
 	
 private:
 	bool ShouldConvertToFloat(unsigned long VertCount, unsigned long IndCount, const double* Verts, const unsigned long* Inds);
-	bool PackVerts(bool bFloatInRange, unsigned long SrcCount, unsigned long long* DestCount, void* Data);
+	static unsigned long long PackVertsCapacity(unsigned long SrcCount, unsigned long ChunkPoints);
+	static unsigned long long PackVertsQuantizedCapacity(unsigned long SrcCount);
+	bool PackVertsQuantized(unsigned long SrcCount, const double* Src, unsigned long long* DestCount, void* Dest);
+	bool PackVerts(bool bFloatInRange, bool bPlanar, unsigned long ChunkPoints, unsigned long SrcCount, const double* Src, unsigned long long* DestCount, void* Dest, unsigned long long DestCapacity);
 	
 private:
-	void PackInds(unsigned long VertCount, unsigned long SrcCount, unsigned long long* DestCount, void* Data);
+	static unsigned long long PackIndsCapacity(unsigned long VertCount, unsigned long SrcCount);
+	void PackInds(unsigned long VertCount, unsigned long SrcCount, const unsigned long* Src, unsigned long long* DestCount, void* Dest);
+	static unsigned long long PackIndsConnectivityCapacity(unsigned long SrcCount);
+	void PackIndsConnectivity(unsigned long SrcCount, const unsigned long* Src, unsigned long long* DestCount, void* Dest);
 
 	
 private:
 	__hidden_GeometryIOProcessor::TempBuffer<unsigned char> TempSrcForEncoding;
 	__hidden_GeometryIOProcessor::TempBuffer<unsigned char> TempDestForEncoding;
+	__hidden_GeometryIOProcessor::TempBuffer<unsigned long> TempTableForEncoding;
+	__hidden_GeometryIOProcessor::TempBuffer<double> TempVertsForWeld;
+	__hidden_GeometryIOProcessor::TempBuffer<unsigned long> TempIndsForWeld;
+	__hidden_GeometryIOProcessor::TempBuffer<double> TempVertsForReorder;
+	__hidden_GeometryIOProcessor::TempBuffer<unsigned long> TempIndsForReorder;
 
 protected:
 	__hidden_GeometryIOProcessor::TempBuffer<char> ErrorMsg;
+
+private:
+	EncodeOptions Options;
+	
+	// lzma encoder kept alive across payloads
+	void* LZMAEncoder;
 };
 
 class GeometryReader : public __hidden_GeometryIOProcessor::CustomIO
@@ -326,8 +499,16 @@ public:
 		: __hidden_GeometryIOProcessor::CustomIO(Alloc, Free)
 		, TempSrcForDecoding(this)
 		, TempDestForDecoding(this)
+		, TempVertsForDecoding(this)
 		, ErrorMsg(this)
+		, DecodeThreadCount(1u)
+		, LastVertexError(0.)
+		, LZMADecoder(nullptr)
 	{}
+	~GeometryReader()
+	{
+		ReleaseDecoder();
+	}
 
 
 public:
@@ -337,6 +518,47 @@ public:
 		return ErrorMsg.Get() ? ErrorMsg.Get() : NullStr;
 	}
 
+public:
+	struct DecodeOptions
+	{
+		enum VertexSpaceType
+		{
+			VERTEX_LOCAL,
+			VERTEX_SCALED,
+			VERTEX_WORLD,
+		};
+
+		// scaled applies Scale to the vertices as they are decoded, world also Rotation and Position. Scale, Rotation and Position are returned as stored either way
+		VertexSpaceType VertexSpace = VERTEX_LOCAL;
+		// subtracted from world space vertices, so that float32 output stays precise around the caller rather than the world origin
+		double Origin[3] = { 0., 0., 0. };
+	};
+
+public:
+	void SetDecodeOptions(const DecodeOptions& NewOptions)
+	{
+		Options = NewOptions;
+	}
+	const DecodeOptions& GetDecodeOptions() const
+	{
+		return Options;
+	}
+	// threads used for payloads made of several lzma2 blocks or fpzip chunks. 1 by default, 0 means one per core. Alloc and Free must be thread-safe unless this is 1
+	void SetDecodeThreadCount(unsigned long ThreadCount)
+	{
+		DecodeThreadCount = ThreadCount;
+	}
+	// largest coordinate error of the last decoded geometry, as recorded by the encoder. 0 unless it was written with MaxVertexError
+	double GetLastVertexError() const
+	{
+		return LastVertexError;
+	}
+
+	
+public:
+	// supplies destination buffers for VertCount and IndCount elements once they are known. returning false aborts decoding
+	typedef bool (*DestAlloc)(void* Context, unsigned long VertCount, unsigned long IndCount, double** Verts, unsigned long** Inds);
+
 	
 public:
 	bool Decode(
@@ -350,24 +572,74 @@ public:
 		double** Verts,
 		unsigned long** Inds
 		);
+	bool Decode(
+		unsigned long long EncodedSize,
+		const unsigned char* EncodedData,
+		double* Scale,
+		double* Rotation,
+		double* Position,
+		unsigned long* VertCount,
+		unsigned long* IndCount,
+		double** Verts,
+		unsigned long** Inds,
+		DestAlloc Alloc,
+		void* Context
+		);
+
+protected:
+	// same as above with the vertices brought into Space instead of the one in the options. with bFloatVerts set, *Verts receives floats instead
+	bool Decode(
+		unsigned long long EncodedSize,
+		const unsigned char* EncodedData,
+		double* Scale,
+		double* Rotation,
+		double* Position,
+		unsigned long* VertCount,
+		unsigned long* IndCount,
+		double** Verts,
+		unsigned long** Inds,
+		DestAlloc Alloc,
+		void* Context,
+		DecodeOptions::VertexSpaceType Space,
+		bool bFloatVerts
+		);
+
+protected:
+	// decompresses SrcLen bytes written by GeometryWriter::Compress into Dest, which holds DestLen bytes on entry. both return the amount actually consumed and produced
+	bool Decompress(unsigned char Codec, const unsigned char* Src, unsigned long long* SrcLen, unsigned char* Dest, unsigned long long* DestLen);
+
+private:
+	bool DecompressLZMA(const unsigned char* Src, unsigned long long* SrcLen, const unsigned char* Prop, unsigned char* Dest, unsigned long long* DestLen);
+	void ReleaseDecoder();
 
 	
 private:
-	bool Unpack(const unsigned char* Ptr, double* Scale, double* Rotation, double* Position, unsigned long* VertCount, unsigned long* IndCount);
+	bool Unpack(const unsigned char* Ptr, DecodeOptions::VertexSpaceType Space, double* Scale, double* Rotation, double* Position, unsigned long* VertCount, unsigned long* IndCount, double** Verts, unsigned long** Inds, DestAlloc Alloc, void* Context, bool bFloatVerts);
 	
 private:
-	bool UnpackVerts(unsigned long SrcCount, const void* InData, bool bFloatInRange, void* OutData);
+	bool UnpackVerts(unsigned long SrcCount, const void* InData, unsigned long long InSize, bool bFloatInRange, bool bPlanar, bool bChunked, const __hidden_GeometryIOProcessor::VertexTransform* Transform, bool bFloatVerts, void* OutData);
+	bool UnpackVertsQuantized(unsigned long SrcCount, const void* InData, unsigned long long InSize, void* OutData);
 	
 private:
 	void UnpackInds(unsigned long VertCount, unsigned long SrcCount, const void* InData, void* OutData);
+	bool UnpackIndsConnectivity(unsigned long SrcCount, const void* InData, unsigned long long InSize, void* OutData);
 
 	
 private:
 	__hidden_GeometryIOProcessor::TempBuffer<unsigned char> TempSrcForDecoding;
 	__hidden_GeometryIOProcessor::TempBuffer<unsigned char> TempDestForDecoding;
+	__hidden_GeometryIOProcessor::TempBuffer<unsigned char> TempVertsForDecoding;
 
 protected:
 	__hidden_GeometryIOProcessor::TempBuffer<char> ErrorMsg;
+
+private:
+	DecodeOptions Options;
+	unsigned long DecodeThreadCount;
+	double LastVertexError;
+	
+	// lzma decoder kept alive across payloads
+	void* LZMADecoder;
 };
 
 
@@ -376,12 +648,32 @@ protected:
 
 class GeometryStreamWriter : private GeometryWriter, public __hidden_GeometryIOProcessor::CustomFileWriter
 {
+public:
+	struct GeometryDesc
+	{
+		const wchar_t* ID;
+		const double* Scale;
+		const double* Rotation;
+		const double* Position;
+		unsigned long VertCount;
+		unsigned long IndCount;
+		const double* Verts;
+		const unsigned long* Inds;
+
+		unsigned long OptionalEncodeOffset = ENCODE_OFFSET;
+		bool OptionalUseFloat32Vertex = false;
+		unsigned long* OptionalVertexRemap = nullptr;
+	};
+
+	
 public:
 	GeometryStreamWriter(MemAlloc Alloc, MemFree Free, FileTell Tell, FileJump Jump, FileWrite Write)
 		: GeometryWriter(Alloc, Free)
 		, __hidden_GeometryIOProcessor::CustomFileWriter(Tell, Jump, Write)
 		, HeaderNames(this)
 		, HeaderMinMaxes(this)
+		, HeaderLocations(this)
+		, HeaderNameTable(this)
 		, Temporal(this)
 		, TemporalErrorMsg(this)
 		, Handle(nullptr)
@@ -396,6 +688,19 @@ public:
 		return GeometryWriter::GetLastError();
 	}
 
+public:
+	typedef GeometryWriter::EncodeOptions EncodeOptions;
+
+	// also used for the header written by EndWrite and by every worker of EmplaceGeometries
+	inline void SetEncodeOptions(const EncodeOptions& NewOptions)
+	{
+		GeometryWriter::SetEncodeOptions(NewOptions);
+	}
+	inline const EncodeOptions& GetEncodeOptions() const
+	{
+		return GeometryWriter::GetEncodeOptions();
+	}
+
 	
 public:
 	template<typename FUNC>
@@ -453,13 +758,21 @@ public:
 		const unsigned long* Inds,
 
 		unsigned long OptionalEncodeOffset = ENCODE_OFFSET,
-		bool OptionalUseFloat32Vertex = false
+		bool OptionalUseFloat32Vertex = false,
+		unsigned long* OptionalVertexRemap = nullptr
 		);
+	// encodes on OptionalThreadCount workers (0 means one per core) and writes in the given order. Alloc and Free must be thread-safe
+	unsigned long long EmplaceGeometries(const GeometryDesc* Descs, unsigned long long Count, unsigned long OptionalThreadCount = 0u);
+
+private:
+	bool CommitGeometry(const wchar_t* ID, unsigned long long EncodedSize, const unsigned char* EncodedData, const __hidden_GeometryIOProcessor::MinMax& GeometryMinMax);
 
 
 private:
 	__hidden_GeometryIOProcessor::TempBuffer<wchar_t> HeaderNames;
 	__hidden_GeometryIOProcessor::TempBuffer<__hidden_GeometryIOProcessor::MinMax> HeaderMinMaxes;
+	__hidden_GeometryIOProcessor::TempBuffer<__hidden_GeometryIOProcessor::Location> HeaderLocations;
+	__hidden_GeometryIOProcessor::TempBuffer<unsigned long> HeaderNameTable;
 	
 	__hidden_GeometryIOProcessor::TempBuffer<unsigned char> Temporal;
 	decltype(ErrorMsg) TemporalErrorMsg;
@@ -477,13 +790,23 @@ public:
 	GeometryStreamReader(MemAlloc Alloc, MemFree Free, FileTell Tell, FileJump Jump, FileRead Read)
 		: GeometryReader(Alloc, Free)
 		, __hidden_GeometryIOProcessor::CustomFileReader(Tell, Jump, Read)
+		, HeaderRaw(this)
 		, HeaderRawNames(this)
 		, HeaderNames(this)
 		, HeaderMinMaxes(this)
+		, HeaderLocations(this)
+		, HeaderNameTable(this)
 		, Temporal(this)
 		, TemporalErrorMsg(this)
 		, Handle(nullptr)
+		, MappedData(nullptr)
+		, MappedSize(0u)
 		, FileBegin(0u)
+		, GeometryCount(0u)
+		, MinMaxView(nullptr)
+		, LocationView(nullptr)
+		, NameTableView(nullptr)
+		, NameTableSize(0u)
 	{}
 
 
@@ -493,6 +816,29 @@ public:
 		return GeometryReader::GetLastError();
 	}
 
+public:
+	typedef GeometryReader::DecodeOptions DecodeOptions;
+
+	// also used by every worker of GetGeometries
+	inline void SetDecodeOptions(const DecodeOptions& NewOptions)
+	{
+		GeometryReader::SetDecodeOptions(NewOptions);
+	}
+	inline const DecodeOptions& GetDecodeOptions() const
+	{
+		return GeometryReader::GetDecodeOptions();
+	}
+	// GetGeometries decodes each payload on a single thread regardless
+	inline void SetDecodeThreadCount(unsigned long ThreadCount)
+	{
+		GeometryReader::SetDecodeThreadCount(ThreadCount);
+	}
+	// not updated by GetGeometries
+	inline double GetLastVertexError() const
+	{
+		return GeometryReader::GetLastVertexError();
+	}
+
 
 public:
 	template<typename FUNC>
@@ -503,6 +849,23 @@ public:
 			return false;
 		}
 
+		return ScopedReadEnd(Func);
+	}
+	template<typename FUNC>
+	bool ScopedRead(const void* Data, unsigned long long Size, unsigned long long Offset, FUNC&& Func)
+	{
+		if (!BeginRead(Data, Size, Offset))
+		{
+			return false;
+		}
+
+		return ScopedReadEnd(Func);
+	}
+
+private:
+	template<typename FUNC>
+	bool ScopedReadEnd(FUNC& Func)
+	{
 		const bool bSucceeded = Func();
 		if (!bSucceeded)
 		{
@@ -534,6 +897,8 @@ public:
 	
 public:
 	bool BeginRead(void* _Handle);
+	// reads from an archive already in memory (e.g. a read-only file mapping). Data is the start of the mapped file and Offset is where the archive begins in it. payloads and header tables are used in place, so Data must outlive EndRead
+	bool BeginRead(const void* Data, unsigned long long Size, unsigned long long Offset = 0u);
 
 public:
 	bool EndRead();
@@ -541,7 +906,7 @@ public:
 public:
 	const unsigned long GetGeometryCount() const
 	{
-		return static_cast<unsigned long>(HeaderMinMaxes.Size());
+		return static_cast<unsigned long>(GeometryCount);
 	}
 	
 	const wchar_t* GetGeometryName(unsigned long Index) const
@@ -550,8 +915,13 @@ public:
 	}
 	const __hidden_GeometryIOProcessor::MinMax& GetGeometryAABB(unsigned long Index) const
 	{
-		return HeaderMinMaxes[Index];
+		return MinMaxView[Index];
+	}
+	unsigned long long GetGeometryEncodedSize(unsigned long Index) const
+	{
+		return LocationView[Index].Size;
 	}
+	unsigned long FindGeometry(const wchar_t* ID) const;
 	bool GetGeometry(
 		unsigned long Index,
 		double* Scale,
@@ -562,6 +932,40 @@ public:
 		double** Verts,
 		unsigned long** Inds
 		);
+	// decodes into the caller's buffers. fails when they are too small, with VertCount and IndCount still set to the required sizes
+	bool GetGeometry(
+		unsigned long Index,
+		double* Scale,
+		double* Rotation,
+		double* Position,
+		unsigned long* VertCount,
+		unsigned long* IndCount,
+		double* Verts,
+		unsigned long VertCapacity,
+		unsigned long* Inds,
+		unsigned long IndCapacity
+		);
+	// decodes into buffers handed out by Func(VertCount, IndCount, double** Verts, unsigned long** Inds), which stay owned by the caller
+	template<typename FUNC>
+	bool GetGeometry(
+		unsigned long Index,
+		double* Scale,
+		double* Rotation,
+		double* Position,
+		unsigned long* VertCount,
+		unsigned long* IndCount,
+		FUNC&& Func
+		)
+	{
+		typedef typename std::remove_reference<FUNC>::type FuncType;
+
+		double* Verts;
+		unsigned long* Inds;
+		return DecodeGeometry(Index, Scale, Rotation, Position, VertCount, IndCount, &Verts, &Inds, [](void* Context, unsigned long VertCount, unsigned long IndCount, double** Verts, unsigned long** Inds) -> bool
+		{
+			return (*static_cast<FuncType*>(Context))(VertCount, IndCount, Verts, Inds);
+		}, const_cast<void*>(static_cast<const void*>(&Func)), GetDecodeOptions().VertexSpace, false);
+	}
 	bool GetGeometry(
 		unsigned long Index,
 		double* Rotation,
@@ -590,19 +994,76 @@ public:
 		float** Verts,
 		unsigned long** Inds
 	);
+
+public:
+	// receives one decoded geometry. Verts and Inds are only valid during the call. returning false stops the remaining work
+	typedef bool (*GeometryCallback)(void* Context, unsigned long Index, const double* Scale, const double* Rotation, const double* Position, unsigned long VertCount, unsigned long IndCount, const double* Verts, const unsigned long* Inds);
+
+	// decodes the given geometries on OptionalThreadCount workers (0 means one per core) and hands each one to Callback as soon as it's done.
+	// Callback is called from the workers concurrently and in no particular order. Alloc and Free must be thread-safe
+	bool GetGeometries(const unsigned long* Indices, unsigned long long Count, GeometryCallback Callback, void* Context, unsigned long OptionalThreadCount = 0u);
+	// same as above with Func(Index, Scale, Rotation, Position, VertCount, IndCount, Verts, Inds)
+	template<typename FUNC>
+	bool GetGeometries(const unsigned long* Indices, unsigned long long Count, FUNC&& Func, unsigned long OptionalThreadCount = 0u)
+	{
+		typedef typename std::remove_reference<FUNC>::type FuncType;
+
+		return GetGeometries(Indices, Count, [](void* Context, unsigned long Index, const double* Scale, const double* Rotation, const double* Position, unsigned long VertCount, unsigned long IndCount, const double* Verts, const unsigned long* Inds) -> bool
+		{
+			return (*static_cast<FuncType*>(Context))(Index, Scale, Rotation, Position, VertCount, IndCount, Verts, Inds);
+		}, const_cast<void*>(static_cast<const void*>(&Func)), OptionalThreadCount);
+	}
 	
 
 private:
+	bool ReadPayload(unsigned long Index, __hidden_GeometryIOProcessor::TempBuffer<unsigned char>* Buffer, const unsigned char** EncodedData);
+	bool DecodeGeometry(
+		unsigned long Index,
+		double* Scale,
+		double* Rotation,
+		double* Position,
+		unsigned long* VertCount,
+		unsigned long* IndCount,
+		double** Verts,
+		unsigned long** Inds,
+		DestAlloc Alloc,
+		void* Context,
+		DecodeOptions::VertexSpaceType Space,
+		bool bFloatVerts
+		);
+	
+private:
+	bool BeginReadStream(void* _Handle);
+	bool BeginReadMapped(const void* Data, unsigned long long Size, unsigned long long Offset);
+	void ResetRead();
+	bool DecodeHeader(const unsigned char* Ptr, unsigned long long Size, unsigned long long HeaderFlags);
+	bool ParseHeader(const unsigned char* Ptr, unsigned long long Size, unsigned long long HeaderFlags);
+	void BuildNameTable();
+	
+
+private:
+	__hidden_GeometryIOProcessor::TempBuffer<unsigned char> HeaderRaw;
 	__hidden_GeometryIOProcessor::TempBuffer<wchar_t> HeaderRawNames;
 	__hidden_GeometryIOProcessor::TempBuffer<const wchar_t*> HeaderNames;
 	__hidden_GeometryIOProcessor::TempBuffer<__hidden_GeometryIOProcessor::MinMax> HeaderMinMaxes;
+	__hidden_GeometryIOProcessor::TempBuffer<__hidden_GeometryIOProcessor::Location> HeaderLocations;
+	__hidden_GeometryIOProcessor::TempBuffer<unsigned long> HeaderNameTable;
 	
 	__hidden_GeometryIOProcessor::TempBuffer<unsigned char> Temporal;
 	decltype(ErrorMsg) TemporalErrorMsg;
 	
 private:
 	void* Handle;
+	const unsigned char* MappedData;
+	unsigned long long MappedSize;
 	unsigned long long FileBegin;
+	unsigned long long GeometryCount;
+
+	// header tables, either in place (mapped data or decoded header) or in the buffers above
+	const __hidden_GeometryIOProcessor::MinMax* MinMaxView;
+	const __hidden_GeometryIOProcessor::Location* LocationView;
+	const unsigned long* NameTableView;
+	unsigned long long NameTableSize;
 };
 
 
@@ -1,7 +1,21 @@
 #include "fpzip.h"
+#include "types.h"
+#include <cstdlib>
 
 fpzipError fpzip_errno;
 
+static void* default_alloc(FPZctx*, size_t size) { return std::malloc(size); }
+static void default_dealloc(FPZctx*, void* ptr) { std::free(ptr); }
+
+FPZctx fpzip_default_ctx = { default_alloc, default_dealloc, fpzipSuccess };
+
+void fpzip_set_error(FPZctx* ctx, fpzipError error)
+{
+  ctx->error = error;
+  if (ctx == &fpzip_default_ctx)
+    fpzip_errno = error;
+}
+
 const char* const fpzip_errstr[] = {
   "success",
   "cannot read stream",
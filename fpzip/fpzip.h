@@ -258,6 +258,34 @@ typedef enum {
 extern_ fpzipError fpzip_errno; /* error code */
 extern_ const char* const fpzip_errstr[]; /* error message indexed by fpzip_errno */
 
+/*
+** Streams opened through the _ctx functions below allocate through the
+** given context and report errors in ctx->error instead of fpzip_errno,
+** so that independent streams may be used concurrently.  The context may
+** be embedded in a larger caller structure and must outlive the stream.
+*/
+
+typedef struct FPZctx {
+  void* (*alloc)(struct FPZctx* ctx, size_t size); /* allocate size bytes */
+  void (*dealloc)(struct FPZctx* ctx, void* ptr);  /* free allocated memory */
+  fpzipError error;                                /* error code */
+} FPZctx;
+
+/* associate memory buffer with compressed input stream using context */
+FPZ*                  /* compressed stream */
+fpzip_read_from_buffer_ctx(
+  FPZctx*     ctx,    /* allocator and error state */
+  const void* buffer  /* pointer to compressed input data */
+);
+
+/* associate memory buffer with compressed output stream using context */
+FPZ*                  /* compressed stream */
+fpzip_write_to_buffer_ctx(
+  FPZctx* ctx,        /* allocator and error state */
+  void*   buffer,     /* pointer to compressed output data */
+  size_t  size        /* size of allocated storage for buffer */
+);
+
 #ifdef __cplusplus
 }
 #endif
@@ -7,10 +7,10 @@
 template <typename T>
 class Front {
 public:
-  Front(uint nx, uint ny, T zero = 0)
-    : zero(zero), dx(1), dy(nx + 1), dz(dy * (ny + 1)), m(mask(dx + dy + dz)),
-      i(0), a(reinterpret_cast<T*>(__fpzip_alloc((m + 1) * sizeof(T)))) {}
-  ~Front() { __fpzip_free(a); }
+  Front(FPZctx* ctx, uint nx, uint ny, T zero = 0)
+    : ctx(ctx), zero(zero), dx(1), dy(nx + 1), dz(dy * (ny + 1)), m(mask(dx + dy + dz)),
+      i(0), a(reinterpret_cast<T*>(ctx->alloc(ctx, (m + 1) * sizeof(T)))) {}
+  ~Front() { ctx->dealloc(ctx, a); }
 
   // fetch neighbor relative to current sample
   const T& operator()(uint x, uint y, uint z) const
@@ -33,6 +33,7 @@ public:
   }
 
 private:
+  FPZctx*const ctx; // allocator
   const T    zero; // default value
   const uint dx;   // front index x offset
   const uint dy;   // front index y offset
@@ -9,18 +9,18 @@
 // period:   max symbols between normalizations (must be < 1<<(bits+1))
 #define period_RCqsmodel 0x400
 
-RCqsmodel::RCqsmodel(bool compress, uint symbols) : RCmodel(symbols), bits(bits_RCqsmodel), targetrescale(period_RCqsmodel)
+RCqsmodel::RCqsmodel(FPZctx* ctx, bool compress, uint symbols) : RCmodel(symbols), ctx(ctx), bits(bits_RCqsmodel), targetrescale(period_RCqsmodel)
 {
   uint n = symbols;
-  symf = reinterpret_cast<uint*>(__fpzip_alloc((n + 1) * sizeof(uint)));
-  cumf = reinterpret_cast<uint*>(__fpzip_alloc((n + 1) * sizeof(uint)));
+  symf = reinterpret_cast<uint*>(ctx->alloc(ctx, (n + 1) * sizeof(uint)));
+  cumf = reinterpret_cast<uint*>(ctx->alloc(ctx, (n + 1) * sizeof(uint)));
   cumf[0] = 0;
   cumf[n] = 1u << bits;
   if (compress)
     search = 0;
   else {
     searchshift = bits - TBLSHIFT;
-    search = reinterpret_cast<uint*>(__fpzip_alloc(((1 << TBLSHIFT) + 1) * sizeof(uint)));
+    search = reinterpret_cast<uint*>(ctx->alloc(ctx, ((1 << TBLSHIFT) + 1) * sizeof(uint)));
   }
   reset();
 }
@@ -30,9 +30,10 @@ RCqsmodel::RCqsmodel(bool compress, uint symbols) : RCmodel(symbols), bits(bits_
 
 RCqsmodel::~RCqsmodel()
 {
-  __fpzip_free(symf);
-  __fpzip_free(cumf);
-  __fpzip_free(search);
+  ctx->dealloc(ctx, symf);
+  ctx->dealloc(ctx, cumf);
+  if (search)
+    ctx->dealloc(ctx, search);
 }
 
 // reinitialize model
@@ -7,9 +7,10 @@
 class RCqsmodel : public RCmodel {
 public:
   // initialization of model
+  // ctx:      allocator
   // compress: true for compression, false for decompression
   // symbols:  number of symbols
-  RCqsmodel(bool compress, uint symbols);
+  RCqsmodel(FPZctx* ctx, bool compress, uint symbols);
   ~RCqsmodel();
 
   // reinitialize model
@@ -29,6 +30,7 @@ private:
   void update();
   void update(uint s);
 
+  FPZctx*const ctx;    // allocator
   const uint bits;     // number of bits of precision for frequencies
 
   uint  left;          // number of symbols until next normalization
@@ -8,14 +8,16 @@
 
 // array meta data and decoder
 struct FPZinput : public FPZ {
+  FPZctx* ctx;
   RCdecoder* rd;
 };
 
 // allocate input stream
 static FPZinput*
-allocate_input()
+allocate_input(FPZctx* ctx)
 {
-  FPZinput* stream = _fpzip_new<FPZinput>();
+  FPZinput* stream = _fpzip_new<FPZinput>(ctx);
+  stream->ctx = ctx;
   stream->type = FPZIP_TYPE_FLOAT;
   stream->prec = 0;
   stream->nx = stream->ny = stream->nz = stream->nf = 1;
@@ -27,6 +29,7 @@ allocate_input()
 template <typename T, uint bits>
 static void
 decompress3d(
+  FPZctx*    ctx,  // allocator
   RCdecoder* rd,   // entropy decoder
   T*         data, // flattened 3D array to decompress to
   uint       nx,   // number of x samples
@@ -36,9 +39,9 @@ decompress3d(
 {
   // initialize decompressor
   typedef PCmap<T, bits> Map;
-  RCmodel* rm = _fpzip_new<RCqsmodel>(false, PCdecoder<T, Map>::symbols);
-  PCdecoder<T, Map>* fd = _fpzip_new<PCdecoder<T, Map>>(rd, &rm);
-  Front<T> f(nx, ny);
+  RCmodel* rm = _fpzip_new<RCqsmodel>(ctx, ctx, false, PCdecoder<T, Map>::symbols);
+  PCdecoder<T, Map>* fd = _fpzip_new<PCdecoder<T, Map>>(ctx, rd, &rm);
+  Front<T> f(ctx, nx, ny);
 
   // decode difference between predicted (p) and actual (a) value
   uint x, y, z;
@@ -57,14 +60,14 @@ decompress3d(
         f.push(a);
       }
 
-  _fpzip_delete(fd);
-  _fpzip_delete(rm);
+  _fpzip_delete(ctx, fd);
+  _fpzip_delete(ctx, rm);
 }
 
 // decompress p-bit float, 2p-bit double
 #define decompress_case(p)\
   case subsize(T, p):\
-    decompress3d<T, subsize(T, p)>(stream->rd, data, stream->nx, stream->ny, stream->nz);\
+    decompress3d<T, subsize(T, p)>(stream->ctx, stream->rd, data, stream->nx, stream->ny, stream->nz);\
     break
 
 // decompress 4D array
@@ -111,7 +114,7 @@ decompress4d(
       decompress_case(31);
       decompress_case(32);
       default:
-        fpzip_errno = fpzipErrorBadPrecision;
+        fpzip_set_error(stream->ctx, fpzipErrorBadPrecision);
         return false;
     }
     data += stream->nx * stream->ny * stream->nz;
@@ -125,9 +128,10 @@ fpzip_read_from_file(
   FILE* file // binary input stream
 )
 {
-  fpzip_errno = fpzipSuccess;
-  FPZinput* stream = allocate_input();
-  stream->rd = _fpzip_new<RCfiledecoder>(file);
+  FPZctx* ctx = &fpzip_default_ctx;
+  fpzip_set_error(ctx, fpzipSuccess);
+  FPZinput* stream = allocate_input(ctx);
+  stream->rd = _fpzip_new<RCfiledecoder>(ctx, file);
   stream->rd->init();
   return static_cast<FPZ*>(stream);
 }
@@ -138,9 +142,19 @@ fpzip_read_from_buffer(
   const void* buffer // pointer to compressed data
 )
 {
-  fpzip_errno = fpzipSuccess;
-  FPZinput* stream = allocate_input();
-  stream->rd = _fpzip_new<RCmemdecoder>(buffer);
+  return fpzip_read_from_buffer_ctx(&fpzip_default_ctx, buffer);
+}
+
+// read compressed stream from memory buffer using context
+FPZ*
+fpzip_read_from_buffer_ctx(
+  FPZctx*     ctx,   // allocator and error state
+  const void* buffer // pointer to compressed data
+)
+{
+  fpzip_set_error(ctx, fpzipSuccess);
+  FPZinput* stream = allocate_input(ctx);
+  stream->rd = _fpzip_new<RCmemdecoder>(ctx, buffer);
   stream->rd->init();
   return static_cast<FPZ*>(stream);
 }
@@ -152,8 +166,8 @@ fpzip_read_close(
 )
 {
   FPZinput* stream = static_cast<FPZinput*>(fpz);
-  _fpzip_delete(stream->rd);
-  _fpzip_delete(stream);
+  _fpzip_delete(stream->ctx, stream->rd);
+  _fpzip_delete(stream->ctx, stream);
 }
 
 // read meta data
@@ -162,24 +176,23 @@ fpzip_read_header(
   FPZ* fpz // stream handle
 )
 {
-  fpzip_errno = fpzipSuccess;
-
   FPZinput* stream = static_cast<FPZinput*>(fpz);
   RCdecoder* rd = stream->rd;
+  fpzip_set_error(stream->ctx, fpzipSuccess);
 
   // magic
   if (rd->decode<uint>(8) != 'f' ||
       rd->decode<uint>(8) != 'p' ||
       rd->decode<uint>(8) != 'z' ||
       rd->decode<uint>(8) != '\0') {
-    fpzip_errno = fpzipErrorBadFormat;
+    fpzip_set_error(stream->ctx, fpzipErrorBadFormat);
     return 0;
   }
 
   // format version
   if (rd->decode<uint>(16) != FPZ_MAJ_VERSION ||
       rd->decode<uint>(8) != FPZ_MIN_VERSION) {
-    fpzip_errno = fpzipErrorBadVersion;
+    fpzip_set_error(stream->ctx, fpzipErrorBadVersion);
     return 0;
   }
 
@@ -203,18 +216,18 @@ fpzip_read(
   void* data // array to read
 )
 {
-  fpzip_errno = fpzipSuccess;
   size_t bytes = 0;
   {
     FPZinput* stream = static_cast<FPZinput*>(fpz);
+    fpzip_set_error(stream->ctx, fpzipSuccess);
     bool success = (stream->type == FPZIP_TYPE_FLOAT
       ? decompress4d(stream, static_cast<float*>(data))
       : decompress4d(stream, static_cast<double*>(data)));
     if (success) {
       RCdecoder* rd = stream->rd;
       if (rd->error) {
-        if (fpzip_errno == fpzipSuccess)
-          fpzip_errno = fpzipErrorReadStream;
+        if (stream->ctx->error == fpzipSuccess)
+          fpzip_set_error(stream->ctx, fpzipErrorReadStream);
       }
       else
         bytes = rd->bytes();
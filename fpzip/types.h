@@ -105,24 +105,28 @@ typedef unsigned long ulong;
   #define UINT64SCNx UINT64PRIx
 #endif
 
-extern void* __fpzip_alloc(size_t);
-extern void __fpzip_free(void*);
-
+#include "fpzip.h"
 #include <utility>
 #include <new>
 
+// context of streams opened without one; mirrors its errors into fpzip_errno
+extern FPZctx fpzip_default_ctx;
+
+// record error in context
+void fpzip_set_error(FPZctx* ctx, fpzipError error);
+
 template<typename T, typename... ARGS>
-T* _fpzip_new(ARGS&&... args)
+T* _fpzip_new(FPZctx* ctx, ARGS&&... args)
 {
-  T* p = static_cast<T*>(__fpzip_alloc(sizeof(T)));
+  T* p = static_cast<T*>(ctx->alloc(ctx, sizeof(T)));
   new (p) T(std::forward<ARGS>(args)...);
   return p;
 }
 template<typename T>
-void _fpzip_delete(T* p)
+void _fpzip_delete(FPZctx* ctx, T* p)
 {
   p->~T();
-  __fpzip_free(p);
+  ctx->dealloc(ctx, p);
 }
 
 #endif
@@ -8,14 +8,16 @@
 
 // array meta data and encoder
 struct FPZoutput : public FPZ {
+  FPZctx* ctx;
   RCencoder* re;
 };
 
 // allocate output stream
 static FPZoutput*
-allocate_output()
+allocate_output(FPZctx* ctx)
 {
-  FPZoutput* stream = _fpzip_new<FPZoutput>();
+  FPZoutput* stream = _fpzip_new<FPZoutput>(ctx);
+  stream->ctx = ctx;
   stream->type = FPZIP_TYPE_FLOAT;
   stream->prec = 0;
   stream->nx = stream->ny = stream->nz = stream->nf = 1;
@@ -27,6 +29,7 @@ allocate_output()
 template <typename T, uint bits>
 static void
 compress3d(
+  FPZctx*    ctx,  // allocator
   RCencoder* re,   // entropy encoder
   const T*   data, // flattened 3D array to compress
   uint       nx,   // number of x samples
@@ -36,9 +39,9 @@ compress3d(
 {
   // initialize compressor
   typedef PCmap<T, bits> Map;
-  RCmodel* rm = _fpzip_new<RCqsmodel>(true, PCencoder<T, Map>::symbols);
-  PCencoder<T, Map>* fe = _fpzip_new<PCencoder<T, Map>>(re, &rm);
-  Front<T> f(nx, ny);
+  RCmodel* rm = _fpzip_new<RCqsmodel>(ctx, ctx, true, PCencoder<T, Map>::symbols);
+  PCencoder<T, Map>* fe = _fpzip_new<PCencoder<T, Map>>(ctx, re, &rm);
+  Front<T> f(ctx, nx, ny);
 
   // encode difference between predicted (p) and actual (a) value
   uint x, y, z;
@@ -57,14 +60,14 @@ compress3d(
         f.push(a);
       }
 
-  _fpzip_delete(fe);
-  _fpzip_delete(rm);
+  _fpzip_delete(ctx, fe);
+  _fpzip_delete(ctx, rm);
 }
 
 // compress p-bit float, 2p-bit double
 #define compress_case(p)\
   case subsize(T, p):\
-    compress3d<T, subsize(T, p)>(stream->re, data, stream->nx, stream->ny, stream->nz);\
+    compress3d<T, subsize(T, p)>(stream->ctx, stream->re, data, stream->nx, stream->ny, stream->nz);\
     break
 
 // compress 4D array
@@ -111,7 +114,7 @@ compress4d(
       compress_case(31);
       compress_case(32);
       default:
-        fpzip_errno = fpzipErrorBadPrecision;
+        fpzip_set_error(stream->ctx, fpzipErrorBadPrecision);
         return false;
     }
     data += stream->nx * stream->ny * stream->nz;
@@ -125,9 +128,10 @@ fpzip_write_to_file(
   FILE* file // binary output stream
 )
 {
-  fpzip_errno = fpzipSuccess;
-  FPZoutput* stream = allocate_output();
-  stream->re = _fpzip_new<RCfileencoder>(file);
+  FPZctx* ctx = &fpzip_default_ctx;
+  fpzip_set_error(ctx, fpzipSuccess);
+  FPZoutput* stream = allocate_output(ctx);
+  stream->re = _fpzip_new<RCfileencoder>(ctx, file);
   return static_cast<FPZ*>(stream);
 }
 
@@ -138,9 +142,20 @@ fpzip_write_to_buffer(
   size_t size    // size of buffer
 )
 {
-  fpzip_errno = fpzipSuccess;
-  FPZoutput* stream = allocate_output();
-  stream->re = _fpzip_new<RCmemencoder>(buffer, size);
+  return fpzip_write_to_buffer_ctx(&fpzip_default_ctx, buffer, size);
+}
+
+// write compressed stream to memory buffer using context
+FPZ*
+fpzip_write_to_buffer_ctx(
+  FPZctx* ctx,    // allocator and error state
+  void*   buffer, // pointer to compressed data
+  size_t  size    // size of buffer
+)
+{
+  fpzip_set_error(ctx, fpzipSuccess);
+  FPZoutput* stream = allocate_output(ctx);
+  stream->re = _fpzip_new<RCmemencoder>(ctx, ctx, buffer, size);
   return static_cast<FPZ*>(stream);
 }
 
@@ -151,8 +166,8 @@ fpzip_write_close(
 )
 {
   FPZoutput* stream = static_cast<FPZoutput*>(fpz);
-  _fpzip_delete(stream->re);
-  _fpzip_delete(stream);
+  _fpzip_delete(stream->ctx, stream->re);
+  _fpzip_delete(stream->ctx, stream);
 }
 
 // write meta data
@@ -161,10 +176,9 @@ fpzip_write_header(
   FPZ* fpz // stream handle
 )
 {
-  fpzip_errno = fpzipSuccess;
-
   FPZoutput* stream = static_cast<FPZoutput*>(fpz);
   RCencoder* re = stream->re;
+  fpzip_set_error(stream->ctx, fpzipSuccess);
 
   // magic
   re->encode<uint>('f', 8);
@@ -187,7 +201,7 @@ fpzip_write_header(
   re->encode<uint>(stream->nf, 32);
 
   if (re->error) {
-    fpzip_errno = fpzipErrorWriteStream;
+    fpzip_set_error(stream->ctx, fpzipErrorWriteStream);
     return 0;
   }
 
@@ -201,10 +215,10 @@ fpzip_write(
   const void* data // array to write
 )
 {
-  fpzip_errno = fpzipSuccess;
   size_t bytes = 0;
   {
     FPZoutput* stream = static_cast<FPZoutput*>(fpz);
+    fpzip_set_error(stream->ctx, fpzipSuccess);
     bool success = (stream->type == FPZIP_TYPE_FLOAT
       ? compress4d(stream, static_cast<const float*>(data))
       : compress4d(stream, static_cast<const double*>(data)));
@@ -212,8 +226,8 @@ fpzip_write(
       RCencoder* re = stream->re;
       re->finish();
       if (re->error) {
-        if (fpzip_errno == fpzipSuccess)
-          fpzip_errno = fpzipErrorWriteStream;
+        if (stream->ctx->error == fpzipSuccess)
+          fpzip_set_error(stream->ctx, fpzipErrorWriteStream);
       }
       else
         bytes = re->bytes();
@@ -54,18 +54,19 @@ private:
 // memory writer for compressed data
 class RCmemencoder : public RCencoder {
 public:
-  RCmemencoder(void* buffer, size_t size) : RCencoder(), ptr((uchar*)buffer), begin(ptr), end(ptr + size) {}
+  RCmemencoder(FPZctx* ctx, void* buffer, size_t size) : RCencoder(), ctx(ctx), ptr((uchar*)buffer), begin(ptr), end(ptr + size) {}
   void putbyte(uint byte)
   {
     if (ptr == end) {
       error = true;
-      fpzip_errno = fpzipErrorBufferOverflow;
+      fpzip_set_error(ctx, fpzipErrorBufferOverflow);
     }
     else
       *ptr++ = (uchar)byte;
   }
   size_t bytes() const { return ptr - begin; }
 private:
+  FPZctx* const ctx;
   uchar* ptr;
   const uchar* const begin;
   const uchar* const end;
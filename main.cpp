@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <vector>
 #include <string>
 #include <iostream>
@@ -5,6 +6,18 @@
 
 #include "GeometryIO.h"
 
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 
 struct Geometry
 {
@@ -75,6 +88,84 @@ static bool CustomFileRead(void* Handle, unsigned long long Size, void* Data)
 }
 
 
+struct MappedFile
+{
+	const void* Data;
+	unsigned long long Size;
+#ifdef _WIN32
+	HANDLE File;
+	HANDLE Mapping;
+#endif
+};
+static bool MapFile(const char* Path, MappedFile* Out)
+{
+#ifdef _WIN32
+	Out->File = CreateFileA(Path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (Out->File == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER Size;
+	if (!GetFileSizeEx(Out->File, &Size))
+	{
+		CloseHandle(Out->File);
+		return false;
+	}
+	Out->Size = static_cast<unsigned long long>(Size.QuadPart);
+
+	Out->Mapping = CreateFileMappingA(Out->File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!Out->Mapping)
+	{
+		CloseHandle(Out->File);
+		return false;
+	}
+
+	Out->Data = MapViewOfFile(Out->Mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!Out->Data)
+	{
+		CloseHandle(Out->Mapping);
+		CloseHandle(Out->File);
+		return false;
+	}
+#else
+	const int File = open(Path, O_RDONLY);
+	if (File == -1)
+	{
+		return false;
+	}
+
+	struct stat Stat;
+	if (fstat(File, &Stat) != 0)
+	{
+		close(File);
+		return false;
+	}
+	Out->Size = static_cast<unsigned long long>(Stat.st_size);
+
+	void* Data = mmap(nullptr, Out->Size, PROT_READ, MAP_SHARED, File, 0);
+	close(File);
+	if (Data == MAP_FAILED)
+	{
+		return false;
+	}
+	Out->Data = Data;
+#endif
+
+	return true;
+}
+static void UnmapFile(MappedFile* In)
+{
+#ifdef _WIN32
+	UnmapViewOfFile(In->Data);
+	CloseHandle(In->Mapping);
+	CloseHandle(In->File);
+#else
+	munmap(const_cast<void*>(In->Data), In->Size);
+#endif
+}
+
+
 static Geometry MakeRandomGeom()
 {
 	Geometry Output;
@@ -292,6 +383,75 @@ static bool operator!=(const Geometry& Lhs, const Geometry& Rhs)
 }
 
 
+static bool ReadGeometries(GeometryStreamReader& Processor, std::vector<Geometry>& Geoms)
+{
+	unsigned long e = Processor.GetGeometryCount();
+	Geoms.resize(e);
+
+	for(unsigned long i = 0u; i < e; ++i)
+	{
+		Geometry& p = Geoms[i];
+
+		p.Name = Processor.GetGeometryName(i);
+
+		unsigned long VertCount;
+		unsigned long IndCount;
+		if (!Processor.GetGeometry(
+			i,
+			p.Scale,
+			p.Rotation,
+			p.Position,
+			&VertCount,
+			&IndCount,
+			[&p](unsigned long VertCount, unsigned long IndCount, double** Verts, unsigned long** Inds)
+			{
+				p.Verts.resize(VertCount);
+				p.Inds.resize(IndCount);
+
+				(*Verts) = p.Verts.data();
+				(*Inds) = p.Inds.data();
+				return true;
+			}
+			))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+static bool ReadGeometriesParallel(GeometryStreamReader& Processor, std::vector<Geometry>& Geoms)
+{
+	unsigned long e = Processor.GetGeometryCount();
+	Geoms.resize(e);
+
+	std::vector<unsigned long> Indices(e);
+	for (unsigned long i = 0u; i < e; ++i)
+	{
+		Indices[i] = i;
+		Geoms[i].Name = Processor.GetGeometryName(i);
+	}
+
+	// every geometry lands in its own slot, so the workers don't need to synchronize
+	return Processor.GetGeometries(
+		Indices.data(),
+		Indices.size(),
+		[&Geoms](unsigned long Index, const double* Scale, const double* Rotation, const double* Position, unsigned long VertCount, unsigned long IndCount, const double* Verts, const unsigned long* Inds)
+		{
+			Geometry& p = Geoms[Index];
+
+			std::copy(Scale, Scale + 3, p.Scale);
+			std::copy(Rotation, Rotation + 4, p.Rotation);
+			std::copy(Position, Position + 3, p.Position);
+
+			p.Verts.assign(Verts, Verts + VertCount);
+			p.Inds.assign(Inds, Inds + IndCount);
+			return true;
+		}
+		);
+}
+
+
 int main()
 {
 	const char Filepath[] = "./Test.bin";
@@ -329,21 +489,23 @@ int main()
 
 			if (!Processor.ScopedWrite(f, [&]()
 			{
-				for (const Geometry& i : Geoms)
+				std::vector<GeometryStreamWriter::GeometryDesc> Descs(Geoms.size());
+				for (size_t i = 0u; i < Geoms.size(); ++i)
 				{
-					if (Processor.EmplaceGeometry(
-						i.Name.c_str(),
-						i.Scale,
-						i.Rotation,
-						i.Position,
-						static_cast<unsigned long>(i.Verts.size()),
-						static_cast<unsigned long>(i.Inds.size()),
-						i.Verts.data(),
-						i.Inds.data()
-						) == static_cast<unsigned long long>(-1))
-					{
-						return false;
-					}
+					GeometryStreamWriter::GeometryDesc& Desc = Descs[i];
+					Desc.ID = Geoms[i].Name.c_str();
+					Desc.Scale = Geoms[i].Scale;
+					Desc.Rotation = Geoms[i].Rotation;
+					Desc.Position = Geoms[i].Position;
+					Desc.VertCount = static_cast<unsigned long>(Geoms[i].Verts.size());
+					Desc.IndCount = static_cast<unsigned long>(Geoms[i].Inds.size());
+					Desc.Verts = Geoms[i].Verts.data();
+					Desc.Inds = Geoms[i].Inds.data();
+				}
+
+				if (Processor.EmplaceGeometries(Descs.data(), Descs.size()) == static_cast<unsigned long long>(-1))
+				{
+					return false;
 				}
 
 				return true;
@@ -381,41 +543,36 @@ int main()
 
 			if (!Processor.ScopedRead(f, [&]()
 			{
-				unsigned long e = Processor.GetGeometryCount();
-				DecGeoms.resize(e);
+				return ReadGeometries(Processor, DecGeoms);
+			}))
+			{
+				std:: cout << Processor.GetLastError() << std::endl;
+				break;
+			}
+		}
+		while (false);
 
-				for(unsigned long i = 0u; i < e; ++i)
-				{
-					Geometry& p = DecGeoms[i];
-
-					p.Name = Processor.GetGeometryName(i);
-
-					unsigned long VertCount;
-					unsigned long IndCount;
-					double* Verts;
-					unsigned long* Inds;
-					if (!Processor.GetGeometry(
-						i,
-						p.Scale,
-						p.Rotation,
-						p.Position,
-						&VertCount,
-						&IndCount,
-						&Verts,
-						&Inds
-						))
-					{
-						return false;
-					}
-
-					p.Verts.resize(VertCount);
-					memcpy_s(p.Verts.data(), VertCount << 3u, Verts, VertCount << 3u);
-
-					p.Inds.resize(IndCount);
-					memcpy_s(p.Inds.data(), IndCount << 2u, Inds, IndCount << 2u);
-				}
+		if (fclose(f) == -1)
+		{
+			return -1;
+		}
+	}
 
-				return true;
+	std::vector<Geometry> MappedGeoms;
+	{
+		MappedFile Mapped;
+		if (!MapFile(Filepath, &Mapped))
+		{
+			return -1;
+		}
+
+		do
+		{
+			GeometryStreamReader Processor(malloc, free, CustomFileTell, CustomFileJump, CustomFileRead);
+
+			if (!Processor.ScopedRead(Mapped.Data, Mapped.Size, 0u, [&]()
+			{
+				return ReadGeometriesParallel(Processor, MappedGeoms);
 			}))
 			{
 				std:: cout << Processor.GetLastError() << std::endl;
@@ -424,10 +581,23 @@ int main()
 		}
 		while (false);
 
-		if (fclose(f) == -1)
+		UnmapFile(&Mapped);
+	}
+
+	{
+		if (DecGeoms.size() != MappedGeoms.size())
 		{
+			std::cout << "different geometry count found from mapped file: " << "\"" << DecGeoms.size() << "\" \"" << MappedGeoms.size() << "\"" << std::endl;
 			return -1;
 		}
+
+		for (size_t i = 0u, e = DecGeoms.size(); i < e; ++i)
+		{
+			if (DecGeoms[i] != MappedGeoms[i])
+			{
+				continue;
+			}
+		}
 	}
 
 	{